@@ -40,4 +40,5 @@ void advertise(EventQueue *queue)
         print_error(error, "Gap::startAdvertising() failed");
         return;
     }
+    boot_mark(BOOT_CONNECTABLE);
 }
\ No newline at end of file
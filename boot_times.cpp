@@ -0,0 +1,51 @@
+/**
+ * @file boot_times.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief when each part of the boot finished, from reset
+ */
+#include "boot_times.hpp"
+#include "hal.hpp"
+
+#include <cstdio>
+
+static const char *const boot_milestone_names[boot_milestone_count] = {
+    "sensor ready",
+    "game ready",
+    "connectable",
+    "playable",
+    "name read",
+};
+
+static uint32_t boot_times_us[boot_milestone_count];
+static bool boot_reached[boot_milestone_count];
+
+void boot_mark(boot_milestone_t milestone)
+{
+    if (boot_reached[milestone])
+        return;
+    boot_times_us[milestone] = get_clock().now().count();
+    boot_reached[milestone] = true;
+}
+
+bool boot_time(boot_milestone_t milestone, uint32_t *time_us)
+{
+    if (!boot_reached[milestone])
+        return false;
+    *time_us = boot_times_us[milestone];
+    return true;
+}
+
+void print_boot_times()
+{
+    printf("boot (ms after reset):");
+    for (int i = 0; i < boot_milestone_count; i++) {
+        printf("%s %s ", i ? "," : "", boot_milestone_names[i]);
+        if (boot_reached[i])
+            printf("%u", (unsigned)(boot_times_us[i] / 1000));
+        else
+            printf("-");
+    }
+    printf("\n");
+}
@@ -0,0 +1,47 @@
+/**
+ * @file boot_times.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief when each part of the boot finished, from reset
+ */
+#ifndef BOOT_TIMES_HPP
+#define BOOT_TIMES_HPP
+
+#include <cstdint>
+
+/**
+ * @brief Boot milestones. They are reached in any order, the steps
+ *        leading to them run side by side.
+ */
+typedef enum {
+    // the ToF sensor is initialized
+    BOOT_SENSOR_READY,
+    // the game is initialized, with the remembered (or default) player
+    BOOT_GAME_READY,
+    // the BLE stack is up and advertising
+    BOOT_CONNECTABLE,
+    // the game saw the phone connect, a button press starts calibration
+    BOOT_PLAYABLE,
+    // the name was read from the NFC tag
+    BOOT_NAME_READ
+} boot_milestone_t;
+
+#define boot_milestone_count (BOOT_NAME_READ + 1)
+
+/**
+ * @brief Record that milestone was reached now (Clock::now()).
+ *        Only the first call per milestone counts.
+ */
+void boot_mark(boot_milestone_t milestone);
+
+/**
+ * @brief Time milestone was reached, in us.
+ *
+ * @return whether it was reached.
+ */
+bool boot_time(boot_milestone_t milestone, uint32_t *time_us);
+
+void print_boot_times();
+
+#endif
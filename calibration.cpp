@@ -0,0 +1,62 @@
+/**
+ * @file calibration.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief robust estimate of a calibration distance
+ */
+#include "calibration.hpp"
+
+#include <algorithm>
+
+void Calibrator::add(uint32_t distance)
+{
+    if (distance == 0 || _count == calibration_capacity)
+        return;
+
+    // insertion into the sorted samples
+    size_t i = _count++;
+    while (i > 0 && _samples[i - 1] > distance) {
+        _samples[i] = _samples[i - 1];
+        i--;
+    }
+    _samples[i] = distance;
+}
+
+calibration_result_t Calibrator::result() const
+{
+    calibration_result_t result = {0, 0, 0, 0};
+    if (_count == 0)
+        return result;
+
+    // medians of the samples and of their distances to it, in half mm
+    // so that the middle of an even count stays exact
+    uint32_t median2 = _samples[(_count - 1) / 2] + _samples[_count / 2];
+    uint32_t deviations2[calibration_capacity];
+    for (size_t i = 0; i < _count; i++) {
+        uint32_t sample2 = 2 * _samples[i];
+        deviations2[i] = sample2 > median2 ? sample2 - median2 : median2 - sample2;
+    }
+    std::sort(deviations2, deviations2 + _count);
+    uint32_t mad2 = deviations2[(_count - 1) / 2] + deviations2[_count / 2];
+
+    // 1.4826 MAD is the standard deviation for normal noise; mad2 is 4 MAD
+    result.noise_mm = (mad2 * 14826 + 39999) / 40000;
+
+    // at least 1 mm, or a few equal samples would make every other one an outlier
+    uint32_t limit2 = 2 * calibration_outlier_deviations * std::max(result.noise_mm, (uint32_t)1);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < _count; i++) {
+        uint32_t sample2 = 2 * _samples[i];
+        uint32_t deviation2 = sample2 > median2 ? sample2 - median2 : median2 - sample2;
+        if (deviation2 > limit2) {
+            result.outliers++;
+            continue;
+        }
+        sum += _samples[i];
+        result.inliers++;
+    }
+    // the median is always an inlier
+    result.distance = (uint32_t)((sum + result.inliers / 2) / result.inliers);
+    return result;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file calibration.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief robust estimate of where the player holds their hand, and how
+ *        much the readings move while they hold it there.
+ */
+#ifndef CALIBRATION_HPP
+#define CALIBRATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// most samples kept for one calibration distance
+#define calibration_capacity 32
+// samples further than this many robust deviations from the median are outliers
+#define calibration_outlier_deviations 3
+
+/**
+ * @brief What the samples of one calibration distance came to.
+ */
+typedef struct {
+    // mean of the samples that are not outliers, mm, 0 without any
+    uint32_t distance;
+    // robust standard deviation of the samples (1.4826 MAD), mm, rounded up
+    uint32_t noise_mm;
+    uint32_t inliers;
+    uint32_t outliers;
+} calibration_result_t;
+
+/**
+ * @brief Collects the samples of one calibration distance as they come.
+ *
+ * A single reflection off a sleeve or a missed reading is far from the
+ * others, so instead of plain averaging the samples, the ones further than
+ * calibration_outlier_deviations robust deviations from the median are
+ * dropped first. The median absolute deviation (MAD) is what the
+ * deviation is measured with, as one outlier cannot move it either.
+ * Everything is integer; add() keeps the samples sorted, in O(count).
+ */
+class Calibrator
+{
+public:
+    /**
+     * @brief Forget the samples, for a new distance.
+     */
+    void reset() { _count = 0; }
+
+    /**
+     * @brief Add a sample, in mm. 0 (no reading) is ignored, and so are
+     *        samples once calibration_capacity are kept.
+     */
+    void add(uint32_t distance);
+
+    size_t count() const { return _count; }
+
+    /**
+     * @brief The estimate from the samples added since reset().
+     */
+    calibration_result_t result() const;
+
+private:
+    // sorted
+    uint32_t _samples[calibration_capacity];
+    size_t _count = 0;
+};
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * @file console.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief single-key commands on the serial console, to check a board in the field
+ */
+#include "not.hpp"
+
+static FileHandle *console_handle = nullptr;
+// whether read_commands() is already queued
+static volatile bool read_pending = false;
+
+/**
+ * @brief Run the commands typed so far. Runs on the event queue.
+ */
+static void read_commands()
+{
+    read_pending = false;
+
+    char c;
+    while (console_handle->read(&c, 1) == 1) {
+        if (c == 'l') {
+            print_latency();
+            get_score_sink().update_latency();
+        }
+        else if (c == 'r') {
+            reset_latency();
+            printf("Latency histograms cleared.\n");
+        }
+        else if (c == 's') {
+            print_dispatch_stats();
+            print_ranging_stats();
+            print_console_stats();
+        }
+        else if (c == 'b') {
+            print_boot_times();
+        }
+        else if (c == 't') {
+            print_thread_stats();
+        }
+        else if (c == 'd') {
+            print_trace();
+        }
+        else if (c == 'c') {
+            forget_calibration();
+        }
+        else if (c == '?') {
+            printf("l: print the latency histograms (also updates them over BLE)\n");
+            printf("r: clear the latency histograms\n");
+            printf("s: print the event loop, ranging profile and console counters\n");
+            printf("b: print when each part of the boot finished\n");
+            printf("t: print the CPU time and stack high-water mark of each thread\n");
+            printf("d: dump the last game's trace, for sim/replay_trace\n");
+            printf("c: forget the player's calibration, to measure them again at the next start\n");
+        }
+    }
+}
+
+/**
+ * @brief Console sigio handler, may run in interrupt context.
+ */
+static void console_sigio()
+{
+    if (read_pending) return;
+    read_pending = true;
+    queue.call(read_commands);
+}
+
+void console_init()
+{
+    console_handle = mbed_file_handle(STDIN_FILENO);
+    console_handle->set_blocking(false);
+    console_handle->sigio(console_sigio);
+}
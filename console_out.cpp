@@ -0,0 +1,160 @@
+/**
+ * @file console_out.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief game text for the serial console, queued in a ring
+ */
+#include "console_out.hpp"
+#include "hal.hpp"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#define console_line_size 160
+
+/**
+ * @brief One fixed text and its priority.
+ */
+typedef struct {
+    console_priority_t priority;
+    const char *text;
+} message_entry_t;
+
+// constant, so the texts stay in flash
+static constexpr message_entry_t messages[] = {
+    // MSG_CALIBRATION_NEAR
+    {CONSOLE_HIGH,
+     "We will need the readings for a \"near\" distance and a \"far\" distance. \n\n"
+     "Please place your hand relatively close to the sensor (>5 cm, for best experience), and press the blue user button when you're ready. \n"
+     "This will be recorded as your \"near\" distance.\n\n"},
+    // MSG_CALIBRATION_KEPT
+    {CONSOLE_HIGH,
+     "Your calibration from last time is kept, press the blue user button when you're ready.\n\n"},
+    // MSG_CALIBRATION_FAR
+    {CONSOLE_HIGH,
+     "Now move your hand farther the sensor (move >10 cm, for best experience), and press the blue user button when you're ready.\n"
+     "This will be recorded as your \"far\" distance.\n"},
+    // MSG_CALIBRATION_COMPLETE
+    {CONSOLE_HIGH,
+     "\n\n ===== Calibration Complete! =====\n\n"},
+    // MSG_CALIBRATION_DEFAULTS
+    {CONSOLE_HIGH,
+     "We will be using the default settings instead, and measure you again at the next start.\n\n"},
+    // MSG_TUTORIAL_START
+    {CONSOLE_HIGH,
+     "\n\n ===== Tutorial =====\n\n"
+     "This game is simply played by moving your hand close to or far from the distance sensor according to instructions given.\n"
+     "There are a total of 3 different basic instructions, plus the negation of those 3, making a total of 6.\n"
+     "Instructions will be given using the two LED lights ob the board, which we will walk you through later.\n\n"
+     "You can press the blue user button to progress through this tutorial.\n"
+     "Now, press the button when you're ready to learn about the instructions...\n\n"},
+    // MSG_TUTORIAL_NEAR
+    {CONSOLE_HIGH,
+     "1. \"Near\"\n"
+     "   => the #instruction LED# lights up\n"
+     "   => move your hand near the sensor\n"
+     "   => a \"near\" distance was defined through the calibration earlier\n\n"},
+    // MSG_TUTORIAL_FAR
+    {CONSOLE_HIGH,
+     "2. \"Far\"\n"
+     "   => the #instruction LED# stays off\n"
+     "   => move your hand far from the sensor\n"
+     "   => a \"far\" distance was defined through the calibration earlier\n\n"},
+    // MSG_TUTORIAL_ALT
+    {CONSOLE_HIGH,
+     "3. \"Alternate\"\n"
+     "   => the #instruction LED# flashes\n"
+     "   => *quickly alternate* your hand between near and far\n\n"},
+    // MSG_TUTORIAL_NOT
+    {CONSOLE_HIGH,
+     "4. \"Not\"\n"
+     "   => when the #not LED# lights up, along with any 3 state of the #instruction LED#\n"
+     "   => this *negates* whatever instruction is given by the #instruction LED#, where:\n"
+     "      -> \"not near\" = \"far\"\n"
+     "      -> \"not far\" = \"near\"\n"
+     "      -> \"not alternate\" = \"stay still\", do not move your hand\n\n"},
+    // MSG_TUTORIAL_PAUSE
+    {CONSOLE_HIGH,
+     "5. Pausing the Game\n"
+     "   => at any time of the game, you can press the user button to pause the game play, and the two LEDs will remain the same\n"
+     "   => pressing the button again will resume the game, and a random *new instruction* will be given\n\n"},
+    // MSG_TUTORIAL_GAME_END
+    {CONSOLE_HIGH,
+     "6. Game End\n"
+     "   => for each instruction, the correct move must be made within a given timeframe\n"
+     "   => as the game progresses, this timeframe gets shorter\n"
+     "   => if your move does not match the given instruction, the game ends, and both LEDs would flash\n"
+     "   => you can check your phone for your current score and high score, which is sent via bluetooth\n"
+     "   => TIP: turn on *notify* to have live score updates! \n\n"
+     "Once you're ready, press the user button to start playing the game! \n"},
+    // MSG_GAME_STARTED
+    {CONSOLE_HIGH,
+     "\n\n ===== New Game Started! =====\n\n"},
+    // MSG_GAME_RESUMED
+    {CONSOLE_LOW,
+     " --- Resume Game ---\n"},
+    // MSG_GAME_PAUSED
+    {CONSOLE_LOW,
+     " --- Game Paused ---\n"},
+    // MSG_GAME_END
+    {CONSOLE_HIGH,
+     "\n\n ===== Game END =====\n\n"
+     "Check your phone for your score and high score!\n"
+     "You can press the user button again to start a new game.\n"},
+};
+
+static_assert(sizeof(messages) / sizeof(messages[0]) == message_count, "a message has no text");
+
+static ConsoleRing console_ring;
+console_stats_t console_stats;
+
+/**
+ * @brief Queue size bytes of text whole, or drop them.
+ */
+static void console_write(console_priority_t priority, const char *text, size_t size)
+{
+    uint32_t room = ConsoleRing::capacity() - console_ring.size();
+    size_t needed = size + (priority == CONSOLE_LOW ? console_reserve : 0);
+    if (needed > room) {
+        console_stats.dropped_lines++;
+        console_stats.dropped_bytes += size;
+        return;
+    }
+
+    for (size_t i = 0; i < size; i++)
+        console_ring.push(text[i]);
+    console_stats.lines++;
+    console_stats.bytes += size;
+    get_console_sink().kick(console_ring);
+}
+
+void console_say(message_t message)
+{
+    const message_entry_t &entry = messages[message];
+    console_write(entry.priority, entry.text, strlen(entry.text));
+}
+
+void console_printf(console_priority_t priority, const char *format, ...)
+{
+    char line[console_line_size];
+    va_list args;
+    va_start(args, format);
+    int size = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (size < 0)
+        return;
+    console_write(priority, line, (size_t)size < sizeof(line) ? size : sizeof(line) - 1);
+}
+
+void print_console_stats()
+{
+    printf("console: %u lines, %u bytes (%u ms of UART at 115200 baud), dropped %u lines (%u bytes), "
+           "ring high water %u/%u\n",
+           (unsigned)console_stats.lines, (unsigned)console_stats.bytes,
+           (unsigned)((uint64_t)console_stats.bytes * 100 / 1152),
+           (unsigned)console_stats.dropped_lines, (unsigned)console_stats.dropped_bytes,
+           (unsigned)console_ring.high_water(), (unsigned)ConsoleRing::capacity());
+}
@@ -0,0 +1,77 @@
+/**
+ * @file console_out.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief game text for the serial console, queued in a ring and sent
+ *        by the ConsoleSink (hal.hpp) so the game never waits on the UART
+ */
+#ifndef CONSOLE_OUT_HPP
+#define CONSOLE_OUT_HPP
+
+#include <cstdint>
+
+// bytes kept free for high priority lines, low priority ones are dropped instead
+#define console_reserve 512
+
+/**
+ * @brief What happens to a line the ring has no room for.
+ *
+ * High priority lines may use the whole ring, low priority ones leave
+ * console_reserve bytes for them. A line that does not fit is dropped
+ * whole, and counted; the game is never held up.
+ */
+typedef enum {
+    CONSOLE_LOW,
+    CONSOLE_HIGH
+} console_priority_t;
+
+/**
+ * @brief The fixed texts, see the table in console_out.cpp.
+ */
+typedef enum {
+    MSG_CALIBRATION_NEAR,
+    MSG_CALIBRATION_KEPT,
+    MSG_CALIBRATION_FAR,
+    MSG_CALIBRATION_COMPLETE,
+    MSG_CALIBRATION_DEFAULTS,
+    MSG_TUTORIAL_START,
+    MSG_TUTORIAL_NEAR,
+    MSG_TUTORIAL_FAR,
+    MSG_TUTORIAL_ALT,
+    MSG_TUTORIAL_NOT,
+    MSG_TUTORIAL_PAUSE,
+    MSG_TUTORIAL_GAME_END,
+    MSG_GAME_STARTED,
+    MSG_GAME_RESUMED,
+    MSG_GAME_PAUSED,
+    MSG_GAME_END
+} message_t;
+
+#define message_count (MSG_GAME_END + 1)
+
+/**
+ * @brief What went through the ring.
+ */
+typedef struct {
+    uint32_t lines;
+    uint32_t bytes;
+    uint32_t dropped_lines;
+    uint32_t dropped_bytes;
+} console_stats_t;
+
+extern console_stats_t console_stats;
+
+/**
+ * @brief Queue a fixed text.
+ */
+void console_say(message_t message);
+
+/**
+ * @brief Queue a formatted line, cut to 160 bytes.
+ */
+void console_printf(console_priority_t priority, const char *format, ...);
+
+void print_console_stats();
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file difficulty.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief reaction estimate and difficulty policies
+ */
+#include "difficulty.hpp"
+
+using namespace std::chrono;
+
+void skill_update(player_skill_t &skill, uint32_t reaction_us)
+{
+    if (skill.reactions == 0) {
+        skill.reaction_us = reaction_us;
+        skill.deviation_us = reaction_us / 2;
+    }
+    else {
+        // gains of 1/8 and 1/4, as RFC 6298
+        int32_t error = (int32_t)(reaction_us - skill.reaction_us);
+        uint32_t abs_error = error < 0 ? -error : error;
+        skill.reaction_us += error / 8;
+        skill.deviation_us += ((int32_t)(abs_error - skill.deviation_us)) / 4;
+    }
+    if (skill.reactions < UINT32_MAX)
+        skill.reactions++;
+}
+
+microseconds LinearDifficulty::start(const player_skill_t &)
+{
+    _reaction_avg = 0;
+    return _first;
+}
+
+microseconds LinearDifficulty::next(microseconds rate, const instruction_outcome_t &outcome,
+                                    const player_skill_t &)
+{
+    if (rate > _shortest)
+        rate -= _step;
+    if (!outcome.early)
+        return rate;
+
+    // three times the average reaction, but never slower than the usual curve
+    _reaction_avg = _reaction_avg ? (3 * _reaction_avg + outcome.reaction_us) / 4 : outcome.reaction_us;
+    microseconds reaction_rate(3 * _reaction_avg);
+    if (reaction_rate < rate)
+        rate = reaction_rate;
+    if (rate < _shortest)
+        rate = _shortest;
+    return rate;
+}
+
+microseconds AdaptiveDifficulty::target(const player_skill_t &skill) const
+{
+    if (skill.reactions == 0)
+        return _linear_shortest;
+    return microseconds((uint64_t)skill.reaction_us + (uint64_t)margin * skill.deviation_us);
+}
+
+microseconds AdaptiveDifficulty::clamp(microseconds rate) const
+{
+    if (rate > _first)
+        return _first;
+    if (rate < shortest)
+        return shortest;
+    return rate;
+}
+
+microseconds AdaptiveDifficulty::start(const player_skill_t &skill)
+{
+    microseconds goal = target(skill);
+    _slack = goal < _first ? _first - goal : microseconds(0);
+    return clamp(goal + _slack);
+}
+
+microseconds AdaptiveDifficulty::next(microseconds, const instruction_outcome_t &, const player_skill_t &skill)
+{
+    _slack -= _slack / 16;
+    return clamp(target(skill) + _slack);
+}
@@ -0,0 +1,146 @@
+/**
+ * @file difficulty.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief how long the player gets for each instruction: the running
+ *        estimate of their reaction time, and the policies that turn it
+ *        into the next deadline.
+ */
+#ifndef DIFFICULTY_HPP
+#define DIFFICULTY_HPP
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief What is known of a player's reactions, kept by name in their
+ *        record (player_store.hpp).
+ *
+ * The reaction is the time from an instruction being shown to the first
+ * sample that followed it. Its mean and mean deviation are moving
+ * averages, as TCP estimates round trip times (RFC 6298): mean + 4
+ * deviations is above nearly all of the player's reactions, without
+ * keeping any of them.
+ */
+typedef struct {
+    // us, 0 before the first reaction
+    uint32_t reaction_us;
+    uint32_t deviation_us;
+    // reactions measured so far
+    uint32_t reactions;
+} player_skill_t;
+
+/**
+ * @brief Add a reaction to the estimate.
+ */
+void skill_update(player_skill_t &skill, uint32_t reaction_us);
+
+/**
+ * @brief How the player did on an instruction they got right.
+ */
+typedef struct {
+    int instruction;
+    // ended by early accept
+    bool early;
+    // whether the reaction was measured ("stay still" has none)
+    bool followed;
+    uint32_t reaction_us;
+} instruction_outcome_t;
+
+/**
+ * @brief Picks the time limit of every instruction of a game.
+ *        Only called on the game thread.
+ */
+class DifficultyPolicy
+{
+public:
+    virtual ~DifficultyPolicy() = default;
+
+    virtual const char *name() const = 0;
+
+    /**
+     * @brief Time limit of a new game's first instruction.
+     */
+    virtual std::chrono::microseconds start(const player_skill_t &skill) = 0;
+
+    /**
+     * @brief Time limit of the instruction after one the player got
+     *        right, in rate. skill already holds its reaction.
+     */
+    virtual std::chrono::microseconds next(std::chrono::microseconds rate, const instruction_outcome_t &outcome,
+                                           const player_skill_t &skill) = 0;
+};
+
+/**
+ * @brief The original curve: every instruction is step shorter than the
+ *        last, down to shortest. With early accept, it is also never
+ *        more than 3 times the player's average reaction in this game.
+ *
+ * The parameters are references, so they can be tuned at run time.
+ */
+class LinearDifficulty : public DifficultyPolicy
+{
+public:
+    LinearDifficulty(const std::chrono::microseconds &first, const std::chrono::microseconds &step,
+                     const std::chrono::microseconds &shortest) :
+        _first(first), _step(step), _shortest(shortest)
+    { }
+
+    const char *name() const override { return "linear"; }
+
+    std::chrono::microseconds start(const player_skill_t &skill) override;
+
+    std::chrono::microseconds next(std::chrono::microseconds rate, const instruction_outcome_t &outcome,
+                                   const player_skill_t &skill) override;
+
+private:
+    const std::chrono::microseconds &_first;
+    const std::chrono::microseconds &_step;
+    const std::chrono::microseconds &_shortest;
+    // moving average of the early accepted reactions of this game, us
+    uint32_t _reaction_avg = 0;
+};
+
+/**
+ * @brief Deadlines that follow the player: their reaction estimate plus
+ *        margin deviations, plus a slack that starts at whatever is left
+ *        up to first and shrinks by 1/16 with every right instruction.
+ *        A slow player keeps the time they need, a quick one gets down
+ *        to their own limit. Never longer than first, nor shorter than
+ *        shortest. Until a reaction is measured, the target is
+ *        the linear curve's shortest.
+ */
+class AdaptiveDifficulty : public DifficultyPolicy
+{
+public:
+    AdaptiveDifficulty(const std::chrono::microseconds &first, const std::chrono::microseconds &linear_shortest) :
+        _first(first), _linear_shortest(linear_shortest)
+    { }
+
+    const char *name() const override { return "adaptive"; }
+
+    std::chrono::microseconds start(const player_skill_t &skill) override;
+
+    std::chrono::microseconds next(std::chrono::microseconds rate, const instruction_outcome_t &outcome,
+                                   const player_skill_t &skill) override;
+
+    // deviations above the mean reaction
+    uint32_t margin = 4;
+    // the shortest deadline, whatever the player
+    std::chrono::microseconds shortest = std::chrono::milliseconds(500);
+
+private:
+    /**
+     * @brief Where the deadlines are heading, for this player.
+     */
+    std::chrono::microseconds target(const player_skill_t &skill) const;
+
+    std::chrono::microseconds clamp(std::chrono::microseconds rate) const;
+
+    const std::chrono::microseconds &_first;
+    const std::chrono::microseconds &_linear_shortest;
+    std::chrono::microseconds _slack{0};
+};
+
+#endif
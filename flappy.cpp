@@ -5,42 +5,156 @@
  *
  * @brief main game functions
  */
-#include "not.hpp"
+#include "game.hpp"
+#include "game_fsm.hpp"
+#include "hal.hpp"
+#include "boot_times.hpp"
+#include "calibration.hpp"
+#include "console_out.hpp"
+#include "gesture.hpp"
+#include "instructions.hpp"
+#include "latency.hpp"
+#include "name_capture.hpp"
+#include "player_store.hpp"
 #include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iterator>
 
+using namespace std::chrono_literals;
+
+// set "early-accept" in mbed_app.json to end instructions as soon as they are followed
+#ifndef MBED_CONF_APP_EARLY_ACCEPT
+#define MBED_CONF_APP_EARLY_ACCEPT false
+#endif
+// set "adaptive-difficulty" in mbed_app.json to fit the deadlines to the player's reactions
+#ifndef MBED_CONF_APP_ADAPTIVE_DIFFICULTY
+#define MBED_CONF_APP_ADAPTIVE_DIFFICULTY false
+#endif
+// clear "auto-ranging" in mbed_app.json to range every instruction with the same profile
+#ifndef MBED_CONF_APP_AUTO_RANGING
+#define MBED_CONF_APP_AUTO_RANGING true
+#endif
+// set "trace-store" in mbed_app.json to keep each game's trace in flash once it is over,
+// otherwise only the last game's is kept, in RAM
+#ifndef MBED_CONF_APP_TRACE_STORE
+#define MBED_CONF_APP_TRACE_STORE false
+#endif
+
 // shared variables
 game_state_t game_state;
 tutorial_state_t tutorial_state;
-Timeout timer;
 
 instruction_state_t instruction_state = NEW_INSTRUCTION_ON;
 read_input_state_t read_input_state = READ_INPUT_OFF;
-GameService game_service{};
 
+// devices, see hal.hpp
+static Leds &leds = get_leds();
+static Clock &game_clock = get_clock();
+static ScoreSink &game_service = get_score_sink();
+static SampleRing &samples = get_distance_sensor().samples();
+static EventLoop &event_loop = get_event_loop();
+
+// the current player's record, written back while the game is idle
+PlayerStore player_store(get_record_store());
+// name of the current player
+char current_player[player_name_capacity] = "";
+// a name read during a game, played as once the game is over ("" if none)
+char pending_player[player_name_capacity] = "";
+
+// current score, and the current player's high score
+uint32_t score = 0;
+uint32_t high_score = 0;
 // current instruction
 int instruction;
 // previous instruction
 int prev_instruction = -1;
 // counter for how many times LEDs blinked at end of game
 int end_blink = 0;
-// previous input
-uint32_t prev_input = 0;
-// number of alternations (far to near/near to far) during the current read input period
-int alter_input = 0;
-// minimum distance during the current read input period
-uint32_t min_distance = 0;
-// maximum distance during the current read input period
-uint32_t max_distance = 0;
+// classifies the samples of the current read input period
+GestureClassifier classifier;
+// verdict on the last instruction
+verdict_t last_verdict = {false, 0};
+// start and end of the current read input period, in Clock::now() us
+uint32_t window_start = 0;
+uint32_t window_end = 0;
+// when the pending timeout expires, in Clock::now() us
+uint32_t deadline_us = 0;
+// whether a timeout is pending, stale EVENT_DEADLINEs are dropped
+bool deadline_pending = false;
+// whether the current instruction has been followed yet
+bool window_correct = false;
+// whether the current read input period was ended by accept_early()
+bool window_early = false;
+// when the current instruction's LEDs were written, in Clock::now() us
+uint32_t shown_us = 0;
+// when the last timeout interrupt ran, in Clock::now() us
+uint32_t deadline_fired_us = 0;
+// sample overflow count when the current read input period started
+uint32_t window_overflows = 0;
+// number of read input periods that lost samples to a full ring
+uint32_t lost_sample_windows = 0;
+// sensor faults and stalls when the current read input period started
+uint32_t window_faults = 0;
+uint32_t window_stalls = 0;
+// number of wrong verdicts dropped because the sensor faulted during their period
+uint32_t voided_windows = 0;
 // near distance
 uint32_t near_dist = default_near_dist;
 // far distance
 uint32_t far_dist = default_far_dist;
+// smallest margin added to the calibrated distances
+uint32_t err_value = default_err_value;
+// margin of the current player: err_value, or more if their readings are noisy
+uint32_t player_margin = default_err_value;
+// largest movement that still counts as staying still
+uint32_t still_range = default_err_value * 4 / 5;
+// end an instruction as soon as the right move is seen, instead of at the deadline
+bool early_accept = MBED_CONF_APP_EARLY_ACCEPT;
+// pick the ranging profile of every instruction
+bool auto_ranging = MBED_CONF_APP_AUTO_RANGING;
+// how each ranging profile did
+ranging_stats_t ranging_stats[ranging_profile_count];
+// seed of every game's instructions, 0 to take a new one from the clock
+uint32_t instruction_seed = 0;
+// the current game's instructions
+InstructionSequence instructions;
+// trace of the current game, or of the last one once it is over
+TraceWriter game_trace;
+// time from showing the current instruction to the first sample that followed it,
+// in us; 0 until one does
+uint32_t reaction_time = 0;
+// reaction_time of the last instruction judged, sent with the next one
+uint32_t last_reaction_time = 0;
+// whether a phone is connected, the game only starts once there is one
+bool connected = false;
+// whether the ToF sensor is ranging, it only runs while samples are needed
+bool ranging = false;
+// event loop counters, indexed by game_state_t
+dispatch_stats_t dispatch_stats[game_state_count];
+// when the last event was handled, in Clock::now() us
+uint32_t last_dispatch_us = 0;
+// events that had no transition in the state they arrived in
+uint32_t illegal_transitions = 0;
+// set by game_done() or game_raise(), the current state has finished its work
+bool event_raised = false;
+// the event it raised
+game_event_t raised_event = EVENT_DONE;
 // print flag indicating whether instructions should be printed or not
 bool print_flag = false;
+// whether samples are being collected for the current calibration distance
+bool calibration_collecting = false;
+// the samples collected for the current calibration distance
+Calibrator calibrator;
+// what the near distance's samples came to, until the far one is done
+calibration_result_t near_calibration = {0, 0, 0, 0};
+// when collecting samples for the current calibration distance started
+std::chrono::microseconds calibration_start = 0us;
+// stop collecting after this long, even without enough samples
+std::chrono::microseconds calibration_timeout = 1s;
 
 // the default rate
 std::chrono::microseconds default_rate = 3000ms;
@@ -52,318 +166,936 @@ std::chrono::microseconds rate = default_rate;
 std::chrono::microseconds reduce_rate = 50ms;
 // minimum rate
 std::chrono::microseconds min_rate = 1100ms;
+// the difficulty policies, and the one picking the deadlines
+LinearDifficulty linear_difficulty(default_rate, reduce_rate, min_rate);
+AdaptiveDifficulty adaptive_difficulty(default_rate, min_rate);
+DifficultyPolicy *difficulty = MBED_CONF_APP_ADAPTIVE_DIFFICULTY ?
+    static_cast<DifficultyPolicy *>(&adaptive_difficulty) : &linear_difficulty;
+// how long a blinking LED stays on or off
+std::chrono::milliseconds blink_period = 100ms;
+// how long the LEDs stay on or off when blinking at the end of a game
+std::chrono::milliseconds end_blink_period = 75ms;
 
-void reset_input_globals() {
-    prev_input = 0;
-    alter_input = 0;
-    min_distance = 0;
-    max_distance = 0;
-    end_blink = 0;
+static const char *const game_state_names[] = {
+    "INITIALIZED", "CALIBRATION_NEAR", "CALIBRATION_NEAR_PENDING",
+    "CALIBRATION_FAR", "CALIBRATION_FAR_PENDING", "TUTORIAL", "STARTED",
+    "PAUSED", "PAUSED_PENDING", "ENDING", "ENDED", "ENDED_PENDING"
+};
+static_assert(sizeof(game_state_names) / sizeof(game_state_names[0]) == game_state_count,
+              "a game state has no name");
+
+static const char *const game_event_names[] = {
+    "SAMPLE", "DEADLINE", "BUTTON", "CONNECTED", "DISCONNECTED", "CALIBRATED", "DONE"
+};
+static_assert(sizeof(game_event_names) / sizeof(game_event_names[0]) == game_event_count,
+              "a game event has no name");
+
+// tutorial step shown after each press, the last press starts the game
+static const tutorial_state_t tutorial_next[] = {
+    TUTORIAL_NEAR, TUTORIAL_FAR, TUTORIAL_ALT, TUTORIAL_NOT,
+    TUTORIAL_PAUSE, TUTORIAL_GAME_END, TUTORIAL_GAME_END
+};
+
+void play();
+void pause_game();
+void start_end_blink();
+
+/**
+ * @brief ToF sensor sample handler, runs on the event loop.
+ */
+void sample_handler(uint32_t ready_us) {
+    game_dispatch(EVENT_SAMPLE, ready_us);
+}
+
+/**
+ * @brief Button interrupt handler.
+ */
+void button_handler() {
+    game_post(EVENT_BUTTON);
 }
 
+/**
+ * @brief Event loop handler for game_post().
+ */
+void posted_handler(int event, uint32_t time_us) {
+    game_dispatch((game_event_t)event, time_us);
+}
+
+/**
+ * @brief Interrupt handler for the Timeout.
+ */
 void timeout_handler() {
-    if (game_state == GAME_STARTED) {
-        read_input_state = READ_INPUT_ENDED;
-        if (rate > min_rate)
-            rate -= reduce_rate;
+    game_post(EVENT_DEADLINE);
+}
+
+/**
+ * @brief Post EVENT_DEADLINE at at_us (Clock::now() us), replacing the
+ *        pending one. Already past, it is posted at once.
+ */
+void set_deadline_at(uint32_t at_us) {
+    int32_t delay = (int32_t)(at_us - game_clock.now().count());
+    deadline_us = at_us;
+    deadline_pending = true;
+    game_clock.attach(&timeout_handler, std::chrono::microseconds(delay > 0 ? delay : 0));
+}
+
+/**
+ * @brief Post EVENT_DEADLINE after delay, replacing the pending one.
+ */
+void set_deadline(std::chrono::microseconds delay) {
+    set_deadline_at(game_clock.now().count() + delay.count());
+}
+
+void cancel_deadline() {
+    game_clock.detach();
+    deadline_pending = false;
+}
+
+/**
+ * @brief Start or stop the ToF sensor.
+ */
+void set_ranging(bool on) {
+    if (on == ranging) return;
+    ranging = on;
+
+    if (!on)
+        get_distance_sensor().stop();
+    else if (get_distance_sensor().start_continuous(sample_handler) != 0)
+        console_printf(CONSOLE_HIGH, "[WARNING] ToF sensor failed to start ranging\n");
+}
+
+/**
+ * @brief Switch the ToF sensor to profile, if the game picks them.
+ */
+void set_ranging_profile(ranging_profile_t profile) {
+    if (auto_ranging && get_distance_sensor().set_profile(profile) != 0)
+        console_printf(CONSOLE_HIGH, "[WARNING] ToF sensor failed to switch its ranging profile\n");
+}
+
+/**
+ * @brief The profile to range instruction with, in the current rate.
+ *
+ * "Alternate" needs the most samples, to see every crossing; "stay still"
+ * the least noise, so a steady hand never looks like a move; near and far
+ * only a few samples. Each starts from what it needs most and takes a
+ * shorter budget whenever the time limit cannot hold enough samples of
+ * it, so the profiles tighten as rate comes down to min_rate.
+ */
+ranging_profile_t ranging_profile_for(int instruction) {
+    if (instruction == 2)
+        return RANGING_HIGH_SPEED;
+
+    ranging_profile_t profile = instruction == 12 ? RANGING_HIGH_ACCURACY : RANGING_DEFAULT;
+    uint32_t min_samples = instruction == 12 ? still_min_samples : move_min_samples;
+    while (profile != RANGING_HIGH_SPEED &&
+           (uint64_t)rate.count() < (uint64_t)min_samples * ranging_budget_us[profile])
+        profile = (ranging_profile_t)(profile - 1);
+    return profile;
+}
+
+void game_init() {
+    get_button().rise(button_handler);
+    game_state = GAME_INITIALIZED;
+    tutorial_state = TUTORIAL_START;
+    last_dispatch_us = game_clock.now().count();
+}
+
+/**
+ * @brief Whether record holds a calibration to play with.
+ */
+static bool calibrated(const player_record_t &record) {
+    return record.near_dist != 0 && record.far_dist > record.near_dist;
+}
+
+/**
+ * @brief Margin around the calibrated distances of a player whose
+ *        readings deviate by noise_mm.
+ */
+static uint32_t margin_for(uint32_t noise_mm) {
+    return std::max(err_value, noise_margin * noise_mm);
+}
+
+/**
+ * @brief Tell the player what the first press does: measure their near
+ *        distance, or use the calibration kept in their record.
+ */
+void prompt_calibration() {
+    console_say(calibrated(player_store.record()) ? MSG_CALIBRATION_KEPT : MSG_CALIBRATION_NEAR);
+}
+
+void game_load_player(const char *name) {
+    snprintf(current_player, sizeof(current_player), "%s", name);
+    if (!player_store.load(name)) {
+        // a new player, the current calibration is kept
+        high_score = 0;
+        game_service.update_high_score(high_score);
+        return;
     }
-    else if (game_state == GAME_ENDING) {
-        led1.write(0);
-        led2.write(0);
-        game_state = GAME_ENDED;
+
+    const player_record_t &record = player_store.record();
+    high_score = record.high_score;
+    game_service.update_high_score(high_score);
+    if (calibrated(record)) {
+        near_dist = record.near_dist;
+        far_dist = record.far_dist;
+        player_margin = margin_for(record.noise_mm);
     }
+    console_printf(CONSOLE_LOW, "Welcome back! Games played: %u, high score: %u\n\n",
+                   (unsigned)record.games_played, (unsigned)high_score);
+}
+
+/**
+ * @brief Event loop handler writing the player record back.
+ */
+void store_handler(int, uint32_t) {
+    if (player_store.flush() != 0)
+        console_printf(CONSOLE_HIGH, "[WARNING] could not save the player record\n");
+}
+
+/**
+ * @brief Event loop handler storing the last game's trace.
+ */
+void trace_handler(int, uint32_t) {
+    if (game_trace.save(get_record_store()) != 0)
+        console_printf(CONSOLE_HIGH, "[WARNING] could not save the game trace\n");
+}
+
+/**
+ * @brief Write the player record back once the current event is handled.
+ *        Only call when the game is about to be idle.
+ */
+void save_player() {
+    if (player_store.dirty())
+        event_loop.post(store_handler, 0, 0);
+}
+
+void game_load_remembered_player() {
+    player_store.remembered_name(player_name, player_name_capacity);
+    game_load_player(player_name);
+    boot_mark(BOOT_GAME_READY);
+}
+
+/**
+ * @brief Play as name from now on. Only call while no game is running.
+ */
+void switch_player(const char *name) {
+    // the current player's changes go to their own record first
+    if (player_store.flush() != 0)
+        console_printf(CONSOLE_HIGH, "[WARNING] could not save the player record\n");
+    console_printf(CONSOLE_LOW, "Now playing as *%s*.\n", name);
+    game_load_player(name);
+    if (player_store.remember_name(name) != 0)
+        console_printf(CONSOLE_HIGH, "[WARNING] could not remember the player name\n");
+    // the new player may be calibrated when the last one was not, or the other way round
+    if (connected && game_state == GAME_INITIALIZED)
+        prompt_calibration();
 }
 
 /**
- * @brief small helper that simply blinks LED1 or 2
+ * @brief Event loop handler switching to pending_player once the game is idle.
  */
-void blinky() {
-    led2 = !led2;
-    if (game_state == GAME_ENDING) {
-        led1 = !led1;
-        thread_sleep_for(75);
+void switch_handler(int, uint32_t) {
+    // a press may have got in first
+    if (pending_player[0] == '\0' || !game_idle())
+        return;
+    switch_player(pending_player);
+    pending_player[0] = '\0';
+}
+
+void game_switch_player(const char *name) {
+    if (strcmp(name, current_player) == 0) {
+        pending_player[0] = '\0';
+        return;
     }
-    else if (game_state == GAME_TUTORIAL) {
-        if (tutorial_state == TUTORIAL_GAME_END) led1 = !led1;
-        thread_sleep_for(100);
+    if (game_idle()) {
+        switch_player(name);
+        return;
     }
+    // switching saves records, wait for game_dispatch() to reach an idle state
+    snprintf(pending_player, sizeof(pending_player), "%s", name);
+    // the tutorial runs straight into the first game
+    if (game_state >= GAME_TUTORIAL && game_state <= GAME_ENDED)
+        console_printf(CONSOLE_LOW, "*%s* plays after this game.\n", name);
+    else
+        console_printf(CONSOLE_LOW, "*%s* plays once this calibration step is done.\n", name);
 }
 
-void calibrate() {
-    if (game_state == GAME_CALIBRATION_NEAR)
-        game_state = GAME_CALIBRATION_NEAR_PENDING;
-    else 
-        game_state = GAME_CALIBRATION_FAR_PENDING;
-    
-    uint32_t distance = 0;
-    int count = 0;
+void game_post(game_event_t event) {
+    event_loop.post(posted_handler, event, game_clock.now().count());
+}
+
+/**
+ * @brief The current state has finished, raise event once it returns.
+ */
+void game_raise(game_event_t event) {
+    event_raised = true;
+    raised_event = event;
+}
+
+/**
+ * @brief The current state has finished, raise EVENT_DONE once it returns.
+ */
+void game_done() {
+    game_raise(EVENT_DONE);
+}
+
+// transition actions, run before the game moves to the next state
+
+void button_pressed() {
+    print_flag = true;
+}
+
+void next_tutorial_step() {
+    print_flag = true;
+    if (tutorial_state == TUTORIAL_GAME_END)
+        game_done();
+    else
+        tutorial_state = tutorial_next[tutorial_state];
+}
+
+/**
+ * @brief The read input period is over.
+ */
+void read_deadline() {
+    if (read_input_state == READ_INPUT_ON)
+        read_input_state = READ_INPUT_ENDED;
+}
+
+void end_blink_done() {
+    leds.show(LED_OFF, LED_OFF, blink_period);
+}
+
+void set_connected() {
+    connected = true;
+    boot_mark(BOOT_PLAYABLE);
+    if (game_state == GAME_INITIALIZED)
+        prompt_calibration();
+}
+
+/**
+ * @brief The phone is gone. Before the game started, calibration and the
+ *        tutorial start over with the next phone, so drop what they had.
+ */
+void set_disconnected() {
+    connected = false;
+    if (game_state >= GAME_STARTED)
+        console_printf(CONSOLE_HIGH, "Uh oh, bluetooth is disconnected! The game has ended.\n"
+                       "Connect to *Flappy* again and press the blue user button to start a new game.\n\n");
+    else
+        console_printf(CONSOLE_HIGH, "Uh oh, bluetooth is disconnected!\n"
+                       "Connect to *Flappy* again to calibrate and start the game.\n\n");
+    if (calibration_collecting) {
+        cancel_deadline();
+        set_ranging(false);
+    }
+    calibration_collecting = false;
+    calibrator.reset();
+    tutorial_state = TUTORIAL_START;
+    leds.show(LED_OFF, LED_OFF, blink_period);
+}
+
+/**
+ * @brief What every event does in every state. Events without a rule
+ *        are illegal in that state, they are logged and dropped.
+ */
+static constexpr transition_rule_t game_rules[] = {
+    // state                        event           next                            action
+    {GAME_INITIALIZED,              EVENT_BUTTON,   GAME_CALIBRATION_NEAR,          button_pressed},
+    {GAME_CALIBRATION_NEAR,         EVENT_DEADLINE, same_state,                     nullptr},
+    {GAME_CALIBRATION_NEAR,         EVENT_DONE,     GAME_CALIBRATION_NEAR_PENDING,  nullptr},
+    {GAME_CALIBRATION_NEAR,         EVENT_CALIBRATED, GAME_CALIBRATION_FAR_PENDING, nullptr},
+    {GAME_CALIBRATION_NEAR_PENDING, EVENT_BUTTON,   GAME_CALIBRATION_FAR,           button_pressed},
+    {GAME_CALIBRATION_FAR,          EVENT_DEADLINE, same_state,                     nullptr},
+    {GAME_CALIBRATION_FAR,          EVENT_DONE,     GAME_CALIBRATION_FAR_PENDING,   nullptr},
+    {GAME_CALIBRATION_FAR_PENDING,  EVENT_BUTTON,   GAME_TUTORIAL,                  button_pressed},
+    {GAME_TUTORIAL,                 EVENT_BUTTON,   same_state,                     next_tutorial_step},
+    {GAME_TUTORIAL,                 EVENT_DONE,     GAME_STARTED,                   nullptr},
+    {GAME_STARTED,                  EVENT_BUTTON,   GAME_PAUSED,                    button_pressed},
+    {GAME_STARTED,                  EVENT_DEADLINE, same_state,                     read_deadline},
+    {GAME_STARTED,                  EVENT_DONE,     GAME_ENDING,                    nullptr},
+    {GAME_PAUSED,                   EVENT_DONE,     GAME_PAUSED_PENDING,            nullptr},
+    {GAME_PAUSED_PENDING,           EVENT_BUTTON,   GAME_STARTED,                   button_pressed},
+    {GAME_ENDING,                   EVENT_DEADLINE, GAME_ENDED,                     end_blink_done},
+    {GAME_ENDED,                    EVENT_DONE,     GAME_ENDED_PENDING,             nullptr},
+    {GAME_ENDED_PENDING,            EVENT_BUTTON,   GAME_STARTED,                   button_pressed},
+    // a disconnect before the game started sets it up again, a later one ends the game
+    {GAME_INITIALIZED,              EVENT_DISCONNECTED, same_state,                 set_disconnected},
+    {GAME_CALIBRATION_NEAR,         EVENT_DISCONNECTED, GAME_INITIALIZED,           set_disconnected},
+    {GAME_CALIBRATION_NEAR_PENDING, EVENT_DISCONNECTED, GAME_INITIALIZED,           set_disconnected},
+    {GAME_CALIBRATION_FAR,          EVENT_DISCONNECTED, GAME_INITIALIZED,           set_disconnected},
+    {GAME_CALIBRATION_FAR_PENDING,  EVENT_DISCONNECTED, GAME_INITIALIZED,           set_disconnected},
+    {GAME_TUTORIAL,                 EVENT_DISCONNECTED, GAME_INITIALIZED,           set_disconnected},
+    // presses in the other states are ignored, samples are handled by the state itself
+    {any_state,                     EVENT_BUTTON,   same_state,                     nullptr},
+    {any_state,                     EVENT_SAMPLE,   same_state,                     nullptr},
+    {any_state,                     EVENT_CONNECTED, same_state,                    set_connected},
+    {any_state,                     EVENT_DISCONNECTED, GAME_ENDED,                 set_disconnected},
+};
+
+static constexpr TransitionTable transitions = make_transition_table(game_rules);
+
+static_assert(!has_conflicting_rules(game_rules), "two rules for the same state and event");
+static_assert(all_states_reachable(transitions, GAME_INITIALIZED), "a game state cannot be reached");
+static_assert(handled_everywhere(transitions, EVENT_SAMPLE) &&
+              handled_everywhere(transitions, EVENT_BUTTON) &&
+              handled_everywhere(transitions, EVENT_CONNECTED) &&
+              handled_everywhere(transitions, EVENT_DISCONNECTED),
+              "an outside event is not handled in every state");
+
+/**
+ * @brief What main_game() runs in each state, nullptr to just wait.
+ */
+static constexpr fsm_action_t state_runs[] = {
+    nullptr,            // INITIALIZED
+    calibrate,          // CALIBRATION_NEAR
+    nullptr,            // CALIBRATION_NEAR_PENDING
+    calibrate,          // CALIBRATION_FAR
+    nullptr,            // CALIBRATION_FAR_PENDING
+    tutorial,           // TUTORIAL
+    play,               // STARTED
+    pause_game,         // PAUSED
+    nullptr,            // PAUSED_PENDING
+    start_end_blink,    // ENDING
+    end_game,           // ENDED
+    nullptr             // ENDED_PENDING
+};
+static_assert(sizeof(state_runs) / sizeof(state_runs[0]) == game_state_count,
+              "a game state has no entry in state_runs");
 
-    for (int i = 0; i < 10; i++) {
-        uint32_t input = read_input();
-        distance += input;
+bool game_idle() {
+    return state_runs[game_state] == nullptr && !(game_state >= GAME_STARTED && game_state <= GAME_ENDED);
+}
 
-        if (input > 0)
-            count++;
+/**
+ * @brief Take the transition for event in the current state.
+ *
+ * @return false if the event is illegal in the current state.
+ */
+bool game_transition(game_event_t event) {
+    const transition_t &transition = transitions.at(game_state, event);
+    if (!transition.legal) {
+        illegal_transitions++;
+        console_printf(CONSOLE_HIGH, "[WARNING] no transition from %s on %s\n",
+                       game_state_names[game_state], game_event_names[event]);
+        return false;
     }
 
-    if (count != 0) { // has valid inputs
-        distance /= (count * 1.0);
+    if (transition.action != nullptr)
+        transition.action();
+    game_state = transition.next;
+    return true;
+}
+
+void game_dispatch(game_event_t event, uint32_t time_us) {
+    uint32_t now = game_clock.now().count();
+    dispatch_stats_t &stats = dispatch_stats[game_state];
+    stats.dispatches++;
+    stats.time_us += now - last_dispatch_us;
+    stats.latency_us += now - time_us;
+    if (now - time_us > stats.max_latency_us)
+        stats.max_latency_us = now - time_us;
+    last_dispatch_us = now;
 
-        if (game_state == GAME_CALIBRATION_NEAR_PENDING) 
-            near_dist = distance + err_value;
-        else 
-            far_dist = distance - err_value;
-        
+    // the game only starts once a phone can see the score
+    if (event == EVENT_BUTTON && !connected)
+        return;
+    if (event == EVENT_BUTTON)
+        game_trace.button(time_us);
+    if (event == EVENT_DEADLINE) {
+        // a timeout that was replaced or cancelled after it fired
+        if (!deadline_pending || (int32_t)(time_us - deadline_us) < 0)
+            return;
+        deadline_pending = false;
+        deadline_fired_us = time_us;
+        latency_record(LATENCY_TIMEOUT, time_us - deadline_us);
     }
 
-    if (game_state == GAME_CALIBRATION_NEAR_PENDING) {
-        printf("Now move your hand farther the sensor (move >10 cm, for best experience), and press the blue user button when you're ready.\n");
-        printf("This will be recorded as your \"far\" distance.\n");
+    // run the game until it has to wait for another event
+    do {
+        event_raised = false;
+        if (!game_transition(event))
+            return;
+        // a transition action can finish the state before it runs
+        if (!event_raised)
+            main_game();
+        event = raised_event;
+    } while (event_raised);
+
+    if (pending_player[0] != '\0' && game_idle())
+        event_loop.post(switch_handler, 0, 0);
+}
+
+void print_dispatch_stats() {
+    uint32_t now = game_clock.now().count();
+
+    printf("state                     time (s)  events  events/s  latency mean/max (us)\n");
+    for (int i = 0; i < game_state_count; i++) {
+        const dispatch_stats_t &stats = dispatch_stats[i];
+        uint64_t time_us = stats.time_us + (i == game_state ? now - last_dispatch_us : 0);
+        if (stats.dispatches == 0 && time_us == 0)
+            continue;
+
+        printf("%-25s %8.1f %7u %9.2f %10u /%u\n",
+               game_state_names[i], time_us / 1e6, (unsigned)stats.dispatches,
+               time_us ? stats.dispatches * 1e6 / time_us : 0.0,
+               stats.dispatches ? (unsigned)(stats.latency_us / stats.dispatches) : 0,
+               (unsigned)stats.max_latency_us);
     }
+    printf("illegal transitions: %u\n", (unsigned)illegal_transitions);
+}
+
+void print_ranging_stats() {
+    static const char *const profile_names[] = {"high speed", "default", "high accuracy"};
 
-    if (game_state == GAME_CALIBRATION_FAR_PENDING) {
-        printf("\n\n ===== Calibration Complete! =====\n\n");
+    printf("ranging profile  budget (ms)  periods  samples/s  wrong\n");
+    for (int i = 0; i < ranging_profile_count; i++) {
+        const ranging_stats_t &stats = ranging_stats[i];
+        printf("%-16s %11u %8u %10.1f %6u\n", profile_names[i], (unsigned)(ranging_budget_us[i] / 1000),
+               (unsigned)stats.windows, stats.time_us ? stats.samples * 1e6 / stats.time_us : 0.0,
+               (unsigned)stats.wrong);
+    }
 
-        if (far_dist <= near_dist) {
-            near_dist = default_near_dist;
-            far_dist = default_far_dist;
-            printf("Sorry, the difference between your near and far distances are too small. \n");
-            printf("We will be using the default settings instead.\n\n");
+    SensorStats sensor = get_distance_sensor().stats();
+    printf("sensor: %u samples, %u errors, I2C: %u transactions, %u bytes, %.0f us of bus time a sample\n",
+           (unsigned)sensor.samples, (unsigned)sensor.errors, (unsigned)sensor.bus_transactions,
+           (unsigned)sensor.bus_bytes,
+           sensor.samples + sensor.errors ? (double)sensor.bus_time.count() / (sensor.samples + sensor.errors) : 0.0);
+    printf("sensor errors: bus %u, not ready %u, range %u, lost %u, stall %u, restart %u; "
+           "%u faults, %u instructions not judged\n",
+           (unsigned)sensor.error_counts[SENSOR_ERROR_BUS], (unsigned)sensor.error_counts[SENSOR_ERROR_NOT_READY],
+           (unsigned)sensor.error_counts[SENSOR_ERROR_RANGE], (unsigned)sensor.error_counts[SENSOR_ERROR_LOST],
+           (unsigned)sensor.error_counts[SENSOR_ERROR_STALL], (unsigned)sensor.error_counts[SENSOR_ERROR_RESTART],
+           (unsigned)sensor.faults, (unsigned)voided_windows);
+}
+
+void print_trace() {
+    if (game_trace.active()) {
+        printf("A game is being recorded, dump its trace once it is over.\n");
+        return;
+    }
+    if (game_trace.size() == 0 && game_trace.load(get_record_store()) != 0) {
+        printf("No game trace yet.\n");
+        return;
+    }
+
+    // 32 bytes a line, between markers replay_trace looks for
+    printf("----- trace %u bytes -----\n", (unsigned)game_trace.size());
+    for (size_t i = 0; i < game_trace.size(); i++)
+        printf("%02x%s", game_trace.data()[i], i % 32 == 31 || i + 1 == game_trace.size() ? "\n" : "");
+    printf("----- end of trace -----\n");
+}
+
+void reset_input_globals() {
+    still_range = player_margin * 4 / 5;
+    classifier.configure(near_dist, far_dist, still_range);
+    classifier.reset();
+    end_blink = 0;
+}
+
+/**
+ * @brief Play with the calibration of the current player's record.
+ */
+static void use_stored_calibration() {
+    const player_record_t &record = player_store.record();
+    near_dist = record.near_dist;
+    far_dist = record.far_dist;
+    player_margin = margin_for(record.noise_mm);
+    console_printf(CONSOLE_HIGH, "Your calibration is kept: near %dmm, far %dmm.\n"
+                   "(Type 'c' on the console to calibrate again at the next start.)\n\n",
+                   near_dist - player_margin, far_dist + player_margin);
+    console_printf(CONSOLE_HIGH, "Please press the user button to start the tutorial.\n\n");
+}
+
+/**
+ * @brief Set the thresholds from the near and far samples, or explain
+ *        why the defaults are used instead.
+ */
+static void finish_calibration(const calibration_result_t &near, const calibration_result_t &far) {
+    console_say(MSG_CALIBRATION_COMPLETE);
+    console_printf(CONSOLE_LOW, "near: %umm, %u samples, %u outliers, noise %umm\n"
+                   "far: %umm, %u samples, %u outliers, noise %umm\n\n",
+                   near.distance, near.inliers, near.outliers, near.noise_mm,
+                   far.distance, far.inliers, far.outliers, far.noise_mm);
+
+    // the noisier of the two distances sets the margin of both
+    uint32_t margin = margin_for(std::max(near.noise_mm, far.noise_mm));
+    if (near.inliers == 0 || far.inliers == 0) {
+        console_printf(CONSOLE_HIGH, "Sorry, the sensor did not see your hand at the %s distance.\n",
+                       near.inliers == 0 ? "near" : "far");
+    }
+    else if (far.distance <= near.distance + 2 * margin) {
+        console_printf(CONSOLE_HIGH, "Sorry, your near and far distances are only %umm apart, "
+                       "they need to be more than %umm apart.\n",
+                       far.distance - std::min(near.distance, far.distance), 2 * margin);
+    }
+    else {
+        near_dist = near.distance + margin;
+        far_dist = far.distance - margin;
+        player_margin = margin;
+        player_record_t &record = player_store.record();
+        record.near_dist = near_dist;
+        record.far_dist = far_dist;
+        record.noise_mm = std::max(near.noise_mm, far.noise_mm);
+        player_store.changed();
+        console_printf(CONSOLE_HIGH, "Current near distance: %dmm\nCurrent far distance: %dmm\n\n"
+                       "Please press the user button to start the tutorial.\n\n",
+                       near_dist - player_margin, far_dist + player_margin);
+        return;
+    }
+
+    console_say(MSG_CALIBRATION_DEFAULTS);
+    near_dist = default_near_dist;
+    far_dist = default_far_dist;
+    player_margin = err_value;
+    console_printf(CONSOLE_HIGH, "Default near distance: %dmm\nDefault far distance: %dmm\n\n"
+                   "Please press the user button to start the tutorial.\n\n",
+                   near_dist - player_margin, far_dist + player_margin);
+}
+
+void calibrate() {
+    bool near = game_state == GAME_CALIBRATION_NEAR;
+    std::chrono::microseconds now = game_clock.now();
+    if (!calibration_collecting) {
+        // a returning player is not measured again
+        if (near && calibrated(player_store.record())) {
+            use_stored_calibration();
+            game_raise(EVENT_CALIBRATED);
+            return;
         }
+        calibration_collecting = true;
+        calibrator.reset();
+        calibration_start = now;
+        // the noise, and the margin, are those of the default profile
+        set_ranging_profile(RANGING_DEFAULT);
+        samples.clear();
+        set_ranging(true);
+        set_deadline(calibration_timeout);
+    }
+
+    // samples arrive in the background, take one per sample event
+    calibrator.add(read_input());
 
-        printf("Current near distance: %dmm\n", near_dist - err_value);
-        printf("Current far distance: %dmm\n\n", far_dist + err_value);
-        printf("Please press the user button to start the tutorial.\n\n");
+    // keep collecting until there are enough samples, or the sensor stays silent
+    if (calibrator.count() < calibration_samples && now - calibration_start < calibration_timeout)
+        return;
+    calibration_collecting = false;
+    cancel_deadline();
+    set_ranging(false);
+    game_done();
+
+    if (near) {
+        near_calibration = calibrator.result();
+        console_say(MSG_CALIBRATION_FAR);
+    }
+    else
+        finish_calibration(near_calibration, calibrator.result());
+}
+
+void forget_calibration() {
+    player_record_t &record = player_store.record();
+    if (!calibrated(record)) {
+        console_printf(CONSOLE_LOW, "There is no calibration to forget.\n");
+        return;
     }
+    record.near_dist = 0;
+    record.far_dist = 0;
+    record.noise_mm = 0;
+    player_store.changed();
+    // written now if the game is idle, otherwise when the game ends or pauses
+    if (game_idle())
+        save_player();
+    console_printf(CONSOLE_LOW, "Calibration forgotten, *%s* is measured again at the next start.\n", current_player);
 }
 
 void tutorial() {
     if (tutorial_state == TUTORIAL_START) {
         if (print_flag) {
-            printf("\n\n ===== Tutorial =====\n\n");
-            printf("This game is simply played by moving your hand close to or far from the distance sensor according to instructions given.\n");
-            printf("There are a total of 3 different basic instructions, plus the negation of those 3, making a total of 6.\n");
-            printf("Instructions will be given using the two LED lights ob the board, which we will walk you through later.\n\n");
-            printf("You can press the blue user button to progress through this tutorial.\n");
-            printf("Now, press the button when you're ready to learn about the instructions...\n\n");
+            console_say(MSG_TUTORIAL_START);
             print_flag = false;
         }
     }
     else if (tutorial_state == TUTORIAL_NEAR) {
         if (print_flag) {
-            printf("1. \"Near\"\n");
-            printf("   => the #instruction LED# lights up\n");
-            printf("   => move your hand near the sensor\n");
-            printf("   => a \"near\" distance was defined through the calibration earlier\n\n");
+            console_say(MSG_TUTORIAL_NEAR);
+            leds.show(LED_OFF, LED_ON, blink_period);
             print_flag = false;
         }
-        led2.write(1);
     }
     else if (tutorial_state == TUTORIAL_FAR) {
         if (print_flag) {
-            printf("2. \"Far\"\n");
-            printf("   => the #instruction LED# stays off\n");
-            printf("   => move your hand far from the sensor\n");
-            printf("   => a \"far\" distance was defined through the calibration earlier\n\n");
+            console_say(MSG_TUTORIAL_FAR);
+            leds.show(LED_OFF, LED_OFF, blink_period);
             print_flag = false;
         }
-        led2.write(0);
     }
     else if (tutorial_state == TUTORIAL_ALT) {
         if (print_flag) {
-            printf("3. \"Alternate\"\n");
-            printf("   => the #instruction LED# flashes\n");
-            printf("   => *quickly alternate* your hand between near and far\n\n");
+            console_say(MSG_TUTORIAL_ALT);
+            leds.show(LED_OFF, LED_BLINK, blink_period);
             print_flag = false;
         }
-        blinky();
     }
     else if (tutorial_state == TUTORIAL_NOT) {
         if (print_flag) {
-            printf("4. \"Not\"\n");
-            printf("   => when the #not LED# lights up, along with any 3 state of the #instruction LED#\n");
-            printf("   => this *negates* whatever instruction is given by the #instruction LED#, where:\n");
-            printf("      -> \"not near\" = \"far\"\n");
-            printf("      -> \"not far\" = \"near\"\n");
-            printf("      -> \"not alternate\" = \"stay still\", do not move your hand\n\n");
+            console_say(MSG_TUTORIAL_NOT);
+            leds.show(LED_ON, LED_OFF, blink_period);
             print_flag = false;
         }
-        led2.write(0);
-        led1.write(1);
     }
     else if (tutorial_state == TUTORIAL_PAUSE) {
         if (print_flag) {
-            printf("5. Pausing the Game\n");
-            printf("   => at any time of the game, you can press the user button to pause the game play, and the two LEDs will remain the same\n");
-            printf("   => pressing the button again will resume the game, and a random *new instruction* will be given\n\n");
+            console_say(MSG_TUTORIAL_PAUSE);
             print_flag = false;
         }
     }
     else if (tutorial_state == TUTORIAL_GAME_END) {
         if (print_flag) {
-            printf("6. Game End\n");
-            printf("   => for each instruction, the correct move must be made within a given timeframe\n");
-            printf("   => as the game progresses, this timeframe gets shorter\n");
-            printf("   => if your move does not match the given instruction, the game ends, and both LEDs would flash\n");
-            printf("   => you can check your phone for your current score and high score, which is sent via bluetooth\n");
-            printf("   => TIP: turn on *notify* to have live score updates! \n\n");
-            printf("Once you're ready, press the user button to start playing the game! \n");
-            led2.write(0);
-            led1.write(0);
+            console_say(MSG_TUTORIAL_GAME_END);
+            leds.show(LED_BLINK, LED_BLINK, blink_period);
             print_flag = false;
         }
-        blinky();
     }
 }
 
 void show_lights() {
+    reset_input_globals();
     if (print_flag) {
         if (prev_instruction == -1) {
-            printf("\n\n ===== New Game Started! =====\n\n");
-            game_service.reset_score();
+            console_say(MSG_GAME_STARTED);
+            score = 0;
+            last_reaction_time = 0;
+            game_service.update_score(score);
+            rate = difficulty->start(player_store.record().skill);
+            // the press that started the game is as good a seed as any
+            instructions.start(instruction_seed != 0 ? instruction_seed : game_clock.now().count());
+            console_printf(CONSOLE_HIGH, "Instruction seed: %lu\n", (unsigned long)instructions.seed());
+            game_trace.start(game_clock.now().count(), instructions.seed(), near_dist, far_dist,
+                             still_range, early_accept);
         }
         else
-            printf(" --- Resume Game ---\n");
+            console_say(MSG_GAME_RESUMED);
         print_flag = false;
     }
 
     instruction_state = NEW_INSTRUCTION_OFF;
-    reset_input_globals();
 
-    int not_led = rand() % 2; // 0 or 1
-    int instr_led = rand() % 3; // 0, 1, or 2
     // 0 = far, 1 = near, 2 = alternate
     // 10 = near, 11 = far, 12 = stay still
-    instruction = not_led * 10 + instr_led;
-
-    // "stay still" instruction cannot be first one or right after alternate
-    while (instruction == 12 && (prev_instruction == -1 || prev_instruction == 2)) {
-        not_led = rand() % 2;
-        instr_led = rand() % 3;
-        instruction = not_led * 10 + instr_led;
-    }
+    // "stay still" is never first or right after alternate, see InstructionSequence
+    instruction = instructions.next();
+    int not_led = instruction / 10; // 0 or 1
+    int instr_led = instruction % 10; // 0, 1, or 2
 
-    if (not_led == 1) led1.write(1);
-    else led1.write(0);
-    
-    if (instr_led == 1) led2.write(1);
-    else if (instr_led == 0) led2.write(0);
-    else instruction_state = ALTER_INSTRUCTION_ON;
+    led_mode_t instr_mode = LED_BLINK;
+    if (instr_led == 1) instr_mode = LED_ON;
+    else if (instr_led == 0) instr_mode = LED_OFF;
+    leds.show(not_led == 1 ? LED_ON : LED_OFF, instr_mode, blink_period);
+    shown_us = game_clock.now().count();
+    game_trace.instruction(shown_us, instruction, rate.count());
 
     // printf("current instruction: %d\n", instruction);
     
+    // samples taken before the instruction was shown don't count
+    set_ranging_profile(ranging_profile_for(instruction));
+    set_ranging(true);
+    samples.clear();
+    window_overflows = samples.overflows();
+    SensorStats sensor = get_distance_sensor().stats();
+    window_faults = sensor.faults;
+    window_stalls = sensor.error_counts[SENSOR_ERROR_STALL];
+    window_start = game_clock.now().count();
+    window_correct = false;
+    window_early = false;
+    reaction_time = 0;
+
     read_input_state = READ_INPUT_STARTED;
     prev_instruction = instruction;
 }
 
 uint32_t read_input() {
-    uint32_t distance;
-    int status;
-    status = range.get_distance(&distance);
-
-    if (status == VL53L0X_ERROR_NONE) {
-        if (prev_input != 0) {
-            // from near to far or from far to near
-            if ((prev_input <= near_dist && distance >= far_dist) ||
-                (prev_input >= far_dist && distance <= near_dist))
-                alter_input++;
-            if (distance < min_distance)
-                min_distance = distance;
-            if (distance > max_distance)
-                max_distance = distance;
-        } 
-        else {
-            min_distance = distance;
-            max_distance = distance;
-        }
+    Sample sample;
 
-        prev_input = distance;
-        return distance;
+    if (samples.pop(&sample)) {
+        latency_record(LATENCY_SAMPLE_TO_READ, game_clock.now().count() - sample.time_us);
+        if (read_input_state == READ_INPUT_ON && classifier.count() == 0 &&
+            (int32_t)(sample.time_us - shown_us) >= 0)
+            latency_record(LATENCY_LED_TO_SAMPLE, sample.time_us - shown_us);
+
+        classifier.add_sample(sample.distance);
+        game_trace.sample(sample.time_us, sample.distance);
+        return sample.distance;
     }
     
     return 0;
 }
 
+/**
+ * @brief Feed the samples of the current read input period that arrived
+ *        so far to the classifier, and note when the instruction was first followed.
+ *
+ * @return whether the instruction has been followed.
+ */
+bool read_window() {
+    // only the samples up to the deadline belong to this instruction
+    Sample next;
+    while (samples.peek(&next) && (int32_t)(next.time_us - window_end) <= 0) {
+        read_input();
+        // "stay still" is followed from the start, there is nothing to react to
+        if (!window_correct && instruction != 12 && classifier.verdict(instruction).correct) {
+            window_correct = true;
+            reaction_time = next.time_us - window_start;
+        }
+    }
+    return window_correct;
+}
+
+/**
+ * @brief Early accept - end the read input period now.
+ */
+void accept_early() {
+    cancel_deadline();
+    read_input_state = READ_INPUT_ENDED;
+    window_early = true;
+}
+
 void analyze_input() {
     read_input_state = READ_INPUT_OFF;
 
-    bool input_correct = false;
-    
-    if (((instruction == 0 || instruction == 11) && prev_input >= far_dist) || 
-        ((instruction == 1 || instruction == 10) && prev_input <= near_dist) ||
-        (instruction == 2 && alter_input >= 3) ||
-        (instruction == 12 && (max_distance - min_distance <= err_value * 0.8)))
-        input_correct = true;
-
-    if (input_correct) {
-        game_service.update_score();
+    read_window();
+    if (samples.overflows() != window_overflows)
+        lost_sample_windows++;
+
+    last_verdict = classifier.verdict(instruction);
+    uint32_t verdict_us = game_clock.now().count();
+    ranging_stats_t &ranging = ranging_stats[get_distance_sensor().profile()];
+    ranging.windows++;
+    ranging.samples += classifier.count();
+    ranging.time_us += verdict_us - window_start;
+    ranging.wrong += !last_verdict.correct;
+    game_trace.verdict(verdict_us, last_verdict, window_early, reaction_time);
+    last_reaction_time = reaction_time;
+    if (!window_early) {
+        latency_record(LATENCY_TIMEOUT_TO_VERDICT, verdict_us - deadline_fired_us);
+        // how much longer than rate the instruction really lasted
+        int32_t jitter = (int32_t)(verdict_us - (shown_us + rate.count()));
+        latency_record(LATENCY_DEADLINE_JITTER, jitter > 0 ? jitter : 0);
+    }
+    else if (window_correct)
+        latency_record(LATENCY_SAMPLE_TO_VERDICT, verdict_us - (window_start + reaction_time));
+
+    // the player's reaction, kept with their record
+    player_skill_t &skill = player_store.record().skill;
+    if (window_correct) {
+        skill_update(skill, reaction_time);
+        player_store.changed();
+    }
+
+    // a lost sample here and there leaves plenty to judge by, but a stall
+    // hides a whole move, and so do many lost samples
+    SensorStats sensor = get_distance_sensor().stats();
+    uint32_t periods = (verdict_us - window_start) / ranging_budget_us[get_distance_sensor().profile()];
+    bool spoilt = sensor.error_counts[SENSOR_ERROR_STALL] != window_stalls ||
+                  (sensor.faults != window_faults && classifier.count() * 5 < periods * fault_min_fifths);
+    if (!last_verdict.correct && spoilt) {
+        // the player is not to blame: the instruction is dropped and a new one shown
+        voided_windows++;
+        console_printf(CONSOLE_HIGH, "Sensor fault, instruction %d not judged\n", instruction);
+        instruction_state = NEW_INSTRUCTION_ON;
+    } else if (last_verdict.correct) {
+        instruction_outcome_t outcome = {instruction, window_early, window_correct, reaction_time};
+        rate = difficulty->next(rate, outcome, skill);
+        score++;
+        // the latencies to the GATT write are recorded as it happens
+        game_service.update_point(score, verdict_us, shown_us);
         instruction_state = NEW_INSTRUCTION_ON;
     } else {
-        game_state = GAME_ENDING;
+        game_done();
         instruction_state = END_INSTRUCTION_START;
     }
 }
 
 void main_game() {
-    if (game_state == GAME_CALIBRATION_NEAR || game_state == GAME_CALIBRATION_FAR) {
-        calibrate();
+    fsm_action_t run = state_runs[game_state];
+    if (run != nullptr)
+        run();
+}
+
+/**
+ * @brief Main game - judge the current instruction and show the next one.
+ */
+void play() {
+    if (read_input_state == READ_INPUT_ON) {
+        // "stay still" can only be judged at the deadline
+        if (read_window() && early_accept && instruction != 12)
+            accept_early();
     }
-    else if (game_state == GAME_TUTORIAL) {
-        tutorial();
+
+    if (read_input_state == READ_INPUT_ENDED) {
+        analyze_input();
     }
-    // Do stuff only if currently in game
-    else if (game_state == GAME_STARTED) {
-        // New turn
-        if (instruction_state == NEW_INSTRUCTION_ON) {
-            show_lights();
-        }
-        else if (instruction_state == ALTER_INSTRUCTION_ON) {
-            blinky();
-        }
 
-        if (read_input_state == READ_INPUT_STARTED) {
-            read_input_state = READ_INPUT_ON;
-            timer.attach(&timeout_handler, rate);
-        }
-        // Note that alternation requires multiple input reads
-        // thus needs change later.
-        else if (read_input_state == READ_INPUT_ON) {
-            read_input();
-        }
-        else if (read_input_state == READ_INPUT_ENDED) {
-            analyze_input();
-        }
+    // New turn, straight after the last one was judged
+    if (!event_raised && instruction_state == NEW_INSTRUCTION_ON) {
+        show_lights();
     }
-    else if (game_state == GAME_ENDING) {
-        if (instruction_state == END_INSTRUCTION_START) {
-            led1.write(0);
-            led2.write(0);
-            instruction_state = END_INSTRUCTION_ON;
-            timer.attach(&timeout_handler, 500ms);
-        }
-        blinky();
+
+    if (read_input_state == READ_INPUT_STARTED) {
+        read_input_state = READ_INPUT_ON;
+        // from when the player could see the instruction, whatever
+        // switching the ranging profile took since
+        set_deadline_at(shown_us + rate.count());
+        window_end = deadline_us;
+        game_service.update_instruction(instruction, rate, last_reaction_time);
     }
-    else if (game_state == GAME_PAUSED) {
-        game_state = GAME_PAUSED_PENDING;
-        printf(" --- Game Paused ---\n");
-        instruction_state = NEW_INSTRUCTION_ON;
+}
+
+void pause_game() {
+    game_done();
+    console_say(MSG_GAME_PAUSED);
+    instruction_state = NEW_INSTRUCTION_ON;
+    // the instruction is dropped, a new one is shown on resume
+    cancel_deadline();
+    set_ranging(false);
+    read_input_state = READ_INPUT_OFF;
+    save_player();
+}
+
+/**
+ * @brief Blink both LEDs for a while after a wrong move.
+ */
+void start_end_blink() {
+    if (instruction_state == END_INSTRUCTION_START) {
+        set_ranging(false);
+        leds.show(LED_BLINK, LED_BLINK, end_blink_period);
+        instruction_state = END_INSTRUCTION_ON;
+        set_deadline(500ms);
     }
-    else if (game_state == GAME_ENDED) {
-        end_game();
-    } 
 }
 
 void end_game() {
+    cancel_deadline();
+    set_ranging(false);
     instruction_state = NEW_INSTRUCTION_ON;
     read_input_state = READ_INPUT_OFF;
-    game_state =  GAME_ENDED_PENDING;
+    game_done();
+
+    if (prev_instruction != -1) {
+        player_record_t &record = player_store.record();
+        if (score > high_score) high_score = score;
+        record.high_score = high_score;
+        record.games_played++;
+        player_store.changed();
+
+        game_trace.end(game_clock.now().count(), score);
+        if (MBED_CONF_APP_TRACE_STORE)
+            event_loop.post(trace_handler, 0, 0);
+    }
+    save_player();
 
-    game_service.update_high_score();
-    printf("\n\n ===== Game END =====\n\n");
-    printf("Check your phone for your score and high score!\n");
-    printf("You can press the user button again to start a new game.\n");
+    game_service.update_high_score(high_score);
+    game_service.update_latency();
+    console_say(MSG_GAME_END);
     
     reset_input_globals();
     prev_instruction = -1;
-    rate = default_rate;
 }
@@ -0,0 +1,300 @@
+/**
+ * @file game.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief game logic shared by the board build and the host simulation.
+ *        Nothing in here may depend on mbed, the board talks to the game
+ *        through the interfaces in hal.hpp.
+ */
+#ifndef GAME_HPP
+#define GAME_HPP
+
+#include "difficulty.hpp"
+#include "trace.hpp"
+
+#include <chrono>
+#include <cstdint>
+
+#define default_err_value 50
+#define default_near_dist 150
+#define default_far_dist 250
+#define calibration_samples 16
+// the margin around the calibrated distances is at least this many times
+// the deviation of the player's calibration readings
+#define noise_margin 6
+// fewest samples wanted in the time limit of a "stay still", and of the other instructions
+#define still_min_samples 5
+#define move_min_samples 24
+// a wrong verdict is not judged when the sensor stalled in its read input
+// period, or lost samples and left fewer than this many fifths of them
+#define fault_min_fifths 4
+
+/**
+ * @brief Whether a new instruction needs to be generated.
+ */
+typedef enum {
+    NEW_INSTRUCTION_ON,
+    NEW_INSTRUCTION_OFF,
+    END_INSTRUCTION_START,
+    END_INSTRUCTION_ON
+} instruction_state_t;
+
+/**
+ * @brief Whether the data of the tof sensor needs to be read.
+ */
+typedef enum {
+    READ_INPUT_STARTED,
+    READ_INPUT_ON,
+    READ_INPUT_ENDED,
+    READ_INPUT_OFF
+} read_input_state_t;
+
+/**
+ * @brief Determine the current game state.
+ */
+typedef enum {
+    GAME_INITIALIZED,
+    GAME_CALIBRATION_NEAR,
+    GAME_CALIBRATION_NEAR_PENDING,
+    GAME_CALIBRATION_FAR,
+    GAME_CALIBRATION_FAR_PENDING,
+    GAME_TUTORIAL,
+    GAME_STARTED,
+    GAME_PAUSED,
+    GAME_PAUSED_PENDING,
+    GAME_ENDING,
+    GAME_ENDED,
+    GAME_ENDED_PENDING
+} game_state_t;
+
+#define game_state_count (GAME_ENDED_PENDING + 1)
+
+/**
+ * @brief Determine the current tutorial state.
+ *        Essentially an extention of the game state,
+ *        but kept separate for easier use and organization.
+ */
+typedef enum {
+    TUTORIAL_START,
+    TUTORIAL_NEAR,
+    TUTORIAL_FAR,
+    TUTORIAL_ALT,
+    TUTORIAL_NOT,
+    TUTORIAL_PAUSE,
+    TUTORIAL_GAME_END
+} tutorial_state_t;
+
+/**
+ * @brief Everything that can make the game move on.
+ *        Between events the event loop sleeps.
+ */
+typedef enum {
+    EVENT_SAMPLE,
+    EVENT_DEADLINE,
+    EVENT_BUTTON,
+    EVENT_CONNECTED,
+    EVENT_DISCONNECTED,
+    // raised by the game itself when the current state has finished its work:
+    // with the stored calibration of a returning player, or the usual way
+    EVENT_CALIBRATED,
+    EVENT_DONE
+} game_event_t;
+
+#define game_event_count (EVENT_DONE + 1)
+
+/**
+ * @brief Per game state counters of the event loop.
+ */
+typedef struct {
+    // events handled while in the state
+    uint32_t dispatches;
+    // time spent in the state, us
+    uint64_t time_us;
+    // total and worst time from an event happening to it being handled, us
+    uint64_t latency_us;
+    uint32_t max_latency_us;
+} dispatch_stats_t;
+
+/**
+ * @brief Read input periods ranged with one profile, and how they went.
+ */
+typedef struct {
+    uint32_t windows;
+    // samples given to the classifier, and the periods' total length in us
+    uint32_t samples;
+    uint64_t time_us;
+    // periods judged wrong
+    uint32_t wrong;
+} ranging_stats_t;
+
+// shared varaibles across files
+extern game_state_t game_state;
+extern tutorial_state_t tutorial_state;
+extern bool print_flag;
+// current instruction, see show_lights() for the encoding
+extern int instruction;
+// number of read input periods that lost samples to a full ring
+extern uint32_t lost_sample_windows;
+// number of wrong verdicts dropped because the sensor faulted during their period
+extern uint32_t voided_windows;
+// end instructions as soon as they are followed (MBED_CONF_APP_EARLY_ACCEPT)
+extern bool early_accept;
+// pick the ranging profile of every instruction (MBED_CONF_APP_AUTO_RANGING),
+// otherwise the sensor keeps the one it has
+extern bool auto_ranging;
+// how each ranging profile did, indexed by ranging_profile_t
+extern ranging_stats_t ranging_stats[ranging_profile_count];
+// seed of every game's instruction sequence, 0 to seed each game from the clock.
+// Each game logs its seed, setting it here replays that game's instructions.
+extern uint32_t instruction_seed;
+// whether samples are being collected for the current calibration distance
+extern bool calibration_collecting;
+// time from showing the current instruction to the first sample that followed it,
+// in us; 0 until one does
+extern uint32_t reaction_time;
+// trace of the current game, or of the last one once it is over
+extern TraceWriter game_trace;
+// smallest margin added to the calibrated near and far distances, in mm
+extern uint32_t err_value;
+// margin of the current player, at least err_value, in mm
+extern uint32_t player_margin;
+// difficulty: the first instruction's time limit, how much shorter each
+// next one gets, the shortest one, and the current instruction's
+extern std::chrono::microseconds default_rate;
+extern std::chrono::microseconds reduce_rate;
+extern std::chrono::microseconds min_rate;
+extern std::chrono::microseconds rate;
+// the policies for the next deadline, and the one in use (MBED_CONF_APP_ADAPTIVE_DIFFICULTY)
+extern LinearDifficulty linear_difficulty;
+extern AdaptiveDifficulty adaptive_difficulty;
+extern DifficultyPolicy *difficulty;
+
+// event loop counters, indexed by game_state_t
+extern dispatch_stats_t dispatch_stats[game_state_count];
+// events that had no transition in the state they arrived in
+extern uint32_t illegal_transitions;
+// set by game_done() or game_raise() until game_dispatch() takes raised_event
+extern bool event_raised;
+extern game_event_t raised_event;
+
+/**
+ * @brief Reset the game states and register the button handler.
+ *        The devices must be initialized before this is called.
+ */
+void game_init();
+
+/**
+ * @brief Load the named player's record (high score, calibration)
+ *        from the RecordStore.
+ */
+void game_load_player(const char *name);
+
+/**
+ * @brief Load the player remembered from the last boot (or the default
+ *        player_name) so the game can start before any name is read.
+ */
+void game_load_remembered_player();
+
+/**
+ * @brief Play as name from now on, and remember it for the next boot.
+ *        Saving the records can block, so the switch waits for the game
+ *        to be idle: during the tutorial or a game for the game to end,
+ *        during the calibration for its next press prompt.
+ *        Runs on the event loop.
+ */
+void game_switch_player(const char *name);
+
+/**
+ * @brief Whether the game waits for a press with nothing running, and no
+ *        game to resume: the RecordStore can be written and the I2C bus
+ *        used without holding up the sensor. Runs on the event loop.
+ */
+bool game_idle();
+
+/**
+ * @brief Post an event to the event loop, stamped with the current time.
+ *        Safe to call from interrupt context.
+ */
+void game_post(game_event_t event);
+
+/**
+ * @brief Take the transition for event in the current state and run its
+ *        action, without running the new state. An event without a rule
+ *        is logged, counted in illegal_transitions and dropped.
+ *
+ * @return false if the event is illegal in the current state.
+ */
+bool game_transition(game_event_t event);
+
+/**
+ * @brief Handle an event that happened at time_us (Clock::now() in us):
+ *        look up its transition, then run the game until it waits for
+ *        the next event. Runs on the event loop.
+ */
+void game_dispatch(game_event_t event, uint32_t time_us);
+
+/**
+ * @brief Print dispatch_stats.
+ */
+void print_dispatch_stats();
+
+/**
+ * @brief Print ranging_stats.
+ */
+void print_ranging_stats();
+
+/**
+ * @brief Dump the last game's trace to the console in hex, for
+ *        sim/replay_trace. After a reset, the stored one is dumped.
+ */
+void print_trace();
+
+/**
+ * @brief User calibration: the median and spread of the samples at the
+ *        near, then the far distance set the thresholds and the margin.
+ *        A player with a stored calibration skips it.
+ */
+void calibrate();
+
+/**
+ * @brief Drop the current player's stored calibration, so they are
+ *        measured again at the next start. Runs on the event loop.
+ */
+void forget_calibration();
+
+/**
+ * @brief Tutorial that's just reading, looking at lights, and pressing button.
+ */
+void tutorial();
+
+/**
+ * @brief Main game - turn on LED lights according to instruction
+ *        and set current instrunction
+ */
+void show_lights();
+
+/**
+ * @brief Main game - take the oldest sample from the ToF sensor ring.
+ *        return the sample's distance, or 0 if there was none.
+ */
+uint32_t read_input();
+
+/**
+ * @brief Main game - reads the samples of the whole read input period
+ *        and compares them with the current instruction.
+ */
+void analyze_input();
+
+/**
+ * @brief Main game - runs the current state after an event.
+ *        calls the corresponding function from the state table.
+ */
+void main_game();
+
+/**
+ * @brief End of game
+ */
+void end_game();
+
+#endif
@@ -0,0 +1,127 @@
+/**
+ * @file game_fsm.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief compile-time transition table for game_state_t x game_event_t
+ */
+#ifndef GAME_FSM_HPP
+#define GAME_FSM_HPP
+
+#include "game.hpp"
+
+#include <cstddef>
+
+typedef void (*fsm_action_t)();
+
+// a rule for every state, or a rule that stays in the current state
+#define any_state ((game_state_t)game_state_count)
+#define same_state ((game_state_t)game_state_count)
+
+/**
+ * @brief One line of the game's rules: on event in state, run action
+ *        (if any) and move to next.
+ */
+typedef struct {
+    game_state_t state;
+    game_event_t event;
+    game_state_t next;
+    fsm_action_t action;
+} transition_rule_t;
+
+/**
+ * @brief One cell of the transition table.
+ *        Events without a rule in a state are illegal there.
+ */
+typedef struct {
+    bool legal;
+    game_state_t next;
+    fsm_action_t action;
+} transition_t;
+
+/**
+ * @brief Dense state x event table, built from a list of rules at
+ *        compile time so that a lookup is a single index.
+ */
+struct TransitionTable {
+    transition_t cells[game_state_count][game_event_count];
+
+    constexpr const transition_t &at(game_state_t state, game_event_t event) const
+    {
+        return cells[state][event];
+    }
+};
+
+/**
+ * @brief Build the table. Rules for one state win over any_state rules,
+ *        whatever their order.
+ */
+template <size_t N>
+constexpr TransitionTable make_transition_table(const transition_rule_t (&rules)[N])
+{
+    TransitionTable table{};
+    for (int wildcard = 1; wildcard >= 0; wildcard--) {
+        for (size_t i = 0; i < N; i++) {
+            const transition_rule_t &rule = rules[i];
+            if ((rule.state == any_state) != (wildcard == 1))
+                continue;
+
+            for (int s = 0; s < game_state_count; s++) {
+                if (rule.state != any_state && rule.state != s)
+                    continue;
+                transition_t &cell = table.cells[s][rule.event];
+                cell.legal = true;
+                cell.next = rule.next == same_state ? (game_state_t)s : rule.next;
+                cell.action = rule.action;
+            }
+        }
+    }
+    return table;
+}
+
+/**
+ * @brief Whether two rules cover the same state and event.
+ */
+template <size_t N>
+constexpr bool has_conflicting_rules(const transition_rule_t (&rules)[N])
+{
+    for (size_t i = 0; i < N; i++)
+        for (size_t j = i + 1; j < N; j++)
+            if (rules[i].state == rules[j].state && rules[i].event == rules[j].event)
+                return true;
+    return false;
+}
+
+/**
+ * @brief Whether every state can be reached from start.
+ */
+constexpr bool all_states_reachable(const TransitionTable &table, game_state_t start)
+{
+    bool reached[game_state_count] = {};
+    reached[start] = true;
+
+    // at most one new state per pass
+    for (int pass = 0; pass < game_state_count; pass++)
+        for (int s = 0; s < game_state_count; s++)
+            for (int e = 0; reached[s] && e < game_event_count; e++)
+                if (table.cells[s][e].legal)
+                    reached[table.cells[s][e].next] = true;
+
+    for (int s = 0; s < game_state_count; s++)
+        if (!reached[s])
+            return false;
+    return true;
+}
+
+/**
+ * @brief Whether event has a rule in every state.
+ */
+constexpr bool handled_everywhere(const TransitionTable &table, game_event_t event)
+{
+    for (int s = 0; s < game_state_count; s++)
+        if (!table.cells[s][event].legal)
+            return false;
+    return true;
+}
+
+#endif
@@ -3,16 +3,16 @@
 // https://github.com/ARMmbed/mbed-os-example-ble/blob/master/BLE_GattServer_CharacteristicUpdates/source/main.cpp
 
 GameService::GameService() :
-        _score(0),
-        _high_score(0),
-        _score_characteristic(
-            "12345678-abcd-ef12-9900-f6a0003cc8be", 
-            &_score, 
+        _telemetry{0, 0, 0xff, 0, 0, false, 0, 0},
+        _packed{},
+        _telemetry_characteristic(
+            "12345678-abcd-ef12-9900-f6a000007e1e",
+            _packed,
             GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY),
-        _high_score_characteristic(
-            "12345678-abcd-ef12-9900-f6a000032312", 
-            &_high_score, 
-            GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY)
+        _latency{},
+        _latency_characteristic(
+            "12345678-abcd-ef12-9900-f6a000001a7e",
+            _latency)
 {
     
     uint32_t status;
@@ -20,8 +20,8 @@ GameService::GameService() :
     BLE &ble = BLE::Instance();
 
     GattCharacteristic *characteristics[] = { 
-        &_high_score_characteristic, 
-        &_score_characteristic };
+        &_telemetry_characteristic,
+        &_latency_characteristic };
         
     // custom service uuid
     UUID custom_id("98765432-fedc-baba-1999-f6a03cebf3ce");
@@ -32,29 +32,139 @@ GameService::GameService() :
     );
 
     ble.gattServer().addService(flappy_service);
+    ble.gattServer().setEventHandler(this);
 }
 
-void GameService::update_score()
+void GameService::update_score(uint32_t score)
 {
-    _score++;
+    _telemetry.score = score;
+    changed();
+}
 
-    // Communicate the updated _score value over BLE
-    BLE &ble = BLE::Instance();
-    ble.gattServer().write(_score_characteristic.getValueHandle(), &_score, sizeof(uint8_t));
+void GameService::update_point(uint32_t score, uint32_t verdict_us, uint32_t shown_us)
+{
+    _telemetry.score = score;
+    _telemetry.point = true;
+    _telemetry.verdict_us = verdict_us;
+    _telemetry.shown_us = shown_us;
+    changed();
 }
 
-void GameService::reset_score() { 
-    _score = 0; 
-    BLE &ble = BLE::Instance();
-    ble.gattServer().write(_score_characteristic.getValueHandle(), &_score, sizeof(uint8_t));
+void GameService::update_high_score(uint32_t high_score)
+{
+    _telemetry.high_score = high_score;
+    changed();
 }
 
-void GameService::update_high_score()
+void GameService::update_instruction(int instruction, std::chrono::microseconds rate, uint32_t reaction_us)
 {
-    if (_score > _high_score) _high_score = _score;
+    _telemetry.instruction = instruction;
+    _telemetry.rate_ms = std::chrono::duration_cast<std::chrono::milliseconds>(rate).count();
+    _telemetry.reaction_ms = reaction_us / 1000 > UINT16_MAX ? UINT16_MAX : reaction_us / 1000;
+    changed();
+}
+
+void GameService::update_latency()
+{
+    latency_summary_t summary;
+    pack_latency(summary.bytes);
+    if (_latency_channel.push(summary))
+        ble_worker.call(callback(this, &GameService::write_latency));
+}
 
-    // Communicate the updated _high_score value over BLE
+void GameService::write_latency()
+{
+    // only the newest one matters
+    latency_summary_t summary;
+    bool found = false;
+    while (_latency_channel.pop(&summary))
+        found = true;
+    if (!found)
+        return;
+
+    // read only, the phone reads it when it wants it
+    memcpy(_latency, summary.bytes, sizeof(_latency));
     BLE &ble = BLE::Instance();
-    ble.gattServer().write(_high_score_characteristic.getValueHandle(), &_high_score, sizeof(uint8_t));
+    ble.gattServer().write(_latency_characteristic.getValueHandle(), _latency, sizeof(_latency));
+}
+
+void GameService::disconnected()
+{
+    // from the GAP handler, on the ble thread
+    if (_coalescer.reset())
+        flush();
+}
+
+void GameService::onDataSent(const GattDataSentCallbackParams &params)
+{
+    // the notification went out in the last connection event, send what changed since
+    if (_coalescer.sent())
+        flush();
 }
 
+void GameService::changed()
+{
+    // the rest of the event (a point, then the next instruction) goes in the same write
+    if (_publish_pending)
+        return;
+    _publish_pending = true;
+    game_worker.call(callback(this, &GameService::publish));
+}
+
+void GameService::publish()
+{
+    if (!_telemetry_channel.push(_telemetry)) {
+        // the ble thread is behind, the newest telemetry must still get there;
+        // publish() stays on the game thread, the channel's only producer
+        game_worker.call_in(std::chrono::milliseconds(10), callback(this, &GameService::publish));
+        return;
+    }
+    _publish_pending = false;
+    // the point goes to the ble thread once
+    _telemetry.point = false;
+    ble_worker.call(callback(this, &GameService::receive));
+}
+
+void GameService::receive()
+{
+    telemetry_t telemetry;
+    bool found = false;
+    while (_telemetry_channel.pop(&telemetry)) {
+        pack_telemetry(telemetry, _packed);
+        if (telemetry.point) {
+            _point_pending = true;
+            _point_verdict_us = telemetry.verdict_us;
+            _point_shown_us = telemetry.shown_us;
+        }
+        found = true;
+    }
+    if (found && _coalescer.changed())
+        flush();
+}
+
+/**
+ * @brief Record how long a point took to reach the GATT server. Runs on the game thread.
+ */
+static void record_notify_latency(uint32_t verdict_to_notify_us, uint32_t led_to_notify_us)
+{
+    latency_record(LATENCY_VERDICT_TO_NOTIFY, verdict_to_notify_us);
+    latency_record(LATENCY_LED_TO_NOTIFY, led_to_notify_us);
+}
+
+void GameService::flush()
+{
+    BLE &ble = BLE::Instance();
+    bool notify = false;
+    ble.gattServer().areUpdatesEnabled(_telemetry_characteristic, &notify);
+    if (!_coalescer.take(notify))
+        return;
+
+    // Communicate the telemetry over BLE
+    ble.gattServer().write(_telemetry_characteristic.getValueHandle(), _packed, sizeof(_packed));
+    if (_point_pending) {
+        // measured here, recorded on the game thread that owns the histograms
+        uint32_t written_us = get_clock().now().count();
+        game_worker.call(record_notify_latency, written_us - _point_verdict_us, written_us - _point_shown_us);
+        _point_pending = false;
+    }
+}
@@ -17,19 +17,30 @@ void GapHandler::onConnectionComplete(const ble::ConnectionCompleteEvent &event)
 
     // printf("Connection made with %u.\n", event.getConnectionHandle());
     printf("\n\n ===== Connected! =====\n\n");
-    printf("We will need the readings for a \"near\" distance and a \"far\" distance. \n\n");
-    printf("Please place your hand relatively close to the sensor (>5 cm, for best experience), and press the blue user button when you're ready. \n");
-    printf("This will be recorded as your \"near\" distance.\n\n");
 
-    queue.call_every(10ms, main_game);
+    // the game runs on events from here on, nothing polls it;
+    // it prompts for the calibration, unless the player's is kept
+    game_post(EVENT_CONNECTED);
+
+    // after the game handled the connection, so that "playable" is in
+    static bool boot_printed = false;
+    if (!boot_printed) {
+        queue.call(print_boot_times);
+        boot_printed = true;
+    }
 }
 
 void GapHandler::onDisconnectionComplete(const ble::DisconnectionCompleteEvent &event)
 {
     printf("\n\n ===== Disconnected ===== \n\n");
     printf("Disconnected from %u because %u.\n\n", event.getConnectionHandle(), event.getReason());
-    printf("Uh oh, bluetooth is disconnected! The game requires a restart.\n");
-    printf("Please press the black reset button to restart the game.\n\n");
 
-    game_state = GAME_ENDED; 
+    // the game says what happens next, it knows whether one was running
+    game_service.disconnected();
+    game_post(EVENT_DISCONNECTED);
+
+    // a connection stops advertising, the parameters and payload stay set
+    ble_error_t error = BLE::Instance().gap().startAdvertising(ble::LEGACY_ADVERTISING_HANDLE);
+    if (error)
+        print_error(error, "Gap::startAdvertising() failed");
 }
\ No newline at end of file
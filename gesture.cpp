@@ -0,0 +1,123 @@
+/**
+ * @file gesture.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief streaming classifier turning ToF samples into gestures
+ */
+#include "gesture.hpp"
+
+// near <-> far moves needed for "alternate"
+#define min_alternations 3
+
+/**
+ * @brief Confidence from how far value is from a threshold:
+ *        50 right on it, 100 at least scale away.
+ */
+static uint8_t margin_confidence(uint32_t value, uint32_t threshold, uint32_t scale)
+{
+    uint32_t margin = value > threshold ? value - threshold : threshold - value;
+    if (scale == 0 || margin >= scale) return 100;
+    return 50 + 50 * margin / scale;
+}
+
+void GestureClassifier::configure(uint32_t near_dist, uint32_t far_dist, uint32_t still_range)
+{
+    _near = near_dist;
+    _far = far_dist;
+    // a quarter of the gap on each side, so the two bands never overlap
+    _hysteresis = far_dist > near_dist ? (far_dist - near_dist) / 4 : 0;
+    _still_range = still_range;
+}
+
+void GestureClassifier::reset()
+{
+    _count = 0;
+    _ema = 0;
+    _min = 0;
+    _max = 0;
+    _zone = ZONE_UNKNOWN;
+    _side = ZONE_UNKNOWN;
+    _alternations = 0;
+}
+
+uint32_t GestureClassifier::median() const
+{
+    uint32_t a = _raw[0], b = _raw[1], c = _raw[2];
+    if (a > b) { uint32_t t = a; a = b; b = t; }
+    if (b > c) b = c;
+    return a > b ? a : b;
+}
+
+zone_t GestureClassifier::next_zone(uint32_t distance) const
+{
+    // stay in a zone until the hand is clearly out of it
+    if (_zone == ZONE_NEAR && distance <= _near + _hysteresis)
+        return ZONE_NEAR;
+    if (_zone == ZONE_FAR && distance + _hysteresis >= _far)
+        return ZONE_FAR;
+
+    if (distance <= _near) return ZONE_NEAR;
+    if (distance >= _far) return ZONE_FAR;
+    return ZONE_MIDDLE;
+}
+
+void GestureClassifier::add_sample(uint32_t distance)
+{
+    _raw[_count % 3] = distance;
+    _count++;
+
+    uint32_t filtered = (_count >= 3 ? median() : distance) << 8;
+    if (_count == 1) {
+        _ema = filtered;
+        _min = filtered;
+        _max = filtered;
+    }
+    else {
+        // alpha = 1/2
+        _ema = (_ema + filtered) >> 1;
+        if (_ema < _min) _min = _ema;
+        if (_ema > _max) _max = _ema;
+    }
+
+    zone_t zone = next_zone(_ema >> 8);
+    if (zone != _zone) {
+        if (zone == ZONE_NEAR || zone == ZONE_FAR) {
+            if (_side != ZONE_UNKNOWN && _side != zone)
+                _alternations++;
+            _side = zone;
+        }
+        _zone = zone;
+    }
+}
+
+verdict_t GestureClassifier::verdict(int instruction) const
+{
+    verdict_t verdict = {false, 0};
+    if (_count == 0)
+        return verdict;
+
+    uint32_t band = _hysteresis ? _hysteresis : 1;
+
+    if (instruction == 0 || instruction == 11) { // far
+        verdict.correct = _zone == ZONE_FAR;
+        verdict.confidence = margin_confidence(distance(), _far, band);
+    }
+    else if (instruction == 1 || instruction == 10) { // near
+        verdict.correct = _zone == ZONE_NEAR;
+        verdict.confidence = margin_confidence(distance(), _near, band);
+    }
+    else if (instruction == 2) { // alternate
+        verdict.correct = _alternations >= min_alternations;
+        if (verdict.correct)
+            verdict.confidence = _alternations >= min_alternations + 1 ? 100 : 75;
+        else
+            verdict.confidence = 50 + 50 * (min_alternations - _alternations) / min_alternations;
+    }
+    else if (instruction == 12) { // stay still
+        verdict.correct = range() <= _still_range;
+        verdict.confidence = margin_confidence(range(), _still_range, _still_range);
+    }
+
+    return verdict;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file gesture.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief streaming classifier turning ToF samples into gestures
+ */
+#ifndef GESTURE_HPP
+#define GESTURE_HPP
+
+#include <cstdint>
+
+/**
+ * @brief Where the (filtered) hand is, with hysteresis.
+ */
+typedef enum {
+    ZONE_UNKNOWN,
+    ZONE_NEAR,
+    ZONE_MIDDLE,
+    ZONE_FAR
+} zone_t;
+
+/**
+ * @brief Whether the player followed an instruction, and how sure we are.
+ */
+typedef struct {
+    bool correct;
+    // 0 (no idea) to 100 (certain), about the decision in correct
+    uint8_t confidence;
+} verdict_t;
+
+/**
+ * @brief Classifies the samples of one read input period.
+ *
+ * Every sample costs O(1) integer work: a median of the last 3 samples
+ * removes single-sample spikes, an exponential moving average (Q8 fixed
+ * point) smooths the rest, and the smoothed distance moves between the
+ * near / middle / far zones with hysteresis, so noise around a threshold
+ * cannot count as a move.
+ */
+class GestureClassifier
+{
+public:
+    /**
+     * @brief Set the thresholds.
+     *
+     * @param near_dist   Distance at or below which the hand is near.
+     * @param far_dist    Distance at or above which the hand is far.
+     * @param still_range Largest movement (max - min) that still counts
+     *                    as staying still.
+     */
+    void configure(uint32_t near_dist, uint32_t far_dist, uint32_t still_range);
+
+    /**
+     * @brief Forget the samples, for a new read input period.
+     */
+    void reset();
+
+    /**
+     * @brief Add a sample, in mm.
+     */
+    void add_sample(uint32_t distance);
+
+    /**
+     * @brief Judge the samples so far against an instruction
+     *        (see show_lights() for the encoding).
+     */
+    verdict_t verdict(int instruction) const;
+
+    /**
+     * @brief Smoothed distance in mm, 0 before the first sample.
+     */
+    uint32_t distance() const { return _ema >> 8; }
+
+    zone_t zone() const { return _zone; }
+
+    /**
+     * @brief Number of near <-> far moves.
+     */
+    uint32_t alternations() const { return _alternations; }
+
+    /**
+     * @brief Spread (max - min) of the smoothed distance.
+     */
+    uint32_t range() const { return _count ? (_max - _min) >> 8 : 0; }
+
+    uint32_t count() const { return _count; }
+
+private:
+    uint32_t median() const;
+
+    zone_t next_zone(uint32_t distance) const;
+
+    // thresholds, mm
+    uint32_t _near = 0;
+    uint32_t _far = 0;
+    uint32_t _hysteresis = 0;
+    uint32_t _still_range = 0;
+
+    // last 3 raw samples
+    uint32_t _raw[3] = {0, 0, 0};
+    uint32_t _count = 0;
+
+    // smoothed distance and its extremes, Q8 (mm * 256)
+    uint32_t _ema = 0;
+    uint32_t _min = 0;
+    uint32_t _max = 0;
+
+    zone_t _zone = ZONE_UNKNOWN;
+    // last of ZONE_NEAR / ZONE_FAR the hand was in
+    zone_t _side = ZONE_UNKNOWN;
+    uint32_t _alternations = 0;
+};
+
+#endif
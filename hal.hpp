@@ -0,0 +1,368 @@
+/**
+ * @file hal.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief hardware abstraction layer used by the game logic.
+ *        hal_mbed.cpp implements it on top of the board devices,
+ *        sim/sim_hal.cpp implements it with simulated devices
+ *        running on a virtual clock.
+ */
+#ifndef HAL_HPP
+#define HAL_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "spsc_ring.hpp"
+
+/**
+ * @brief A distance sample, in mm, stamped with when it became ready.
+ */
+struct Sample {
+    // Clock::now() in us, wraps around after ~71 minutes
+    uint32_t time_us;
+    uint32_t distance;
+};
+
+/**
+ * @brief Samples from the sensor to the game, enough for 3 s at 50 Hz
+ *        with some headroom.
+ */
+typedef SpscRing<Sample, 256> SampleRing;
+
+/**
+ * @brief What can go wrong with a sample, each counted on its own.
+ */
+typedef enum {
+    // an I2C transfer failed, it is tried again
+    SENSOR_ERROR_BUS,
+    // the data-ready interrupt came without a new sample
+    SENSOR_ERROR_NOT_READY,
+    // no valid distance (nothing in range, too little signal)
+    SENSOR_ERROR_RANGE,
+    // a sample whose transfers failed sensor_retries times
+    SENSOR_ERROR_LOST,
+    // no sample for sensor_stall_periods periods, the bus and the sensor were reset
+    SENSOR_ERROR_STALL,
+    // the sensor did not start again after a reset, the next stall tries again
+    SENSOR_ERROR_RESTART
+} sensor_error_t;
+
+#define sensor_error_count (SENSOR_ERROR_RESTART + 1)
+
+// tries of a sample's transfers, all within half a period of its data-ready interrupt
+#define sensor_retries 3
+// sample periods without a sample before the sensor counts as stuck
+#define sensor_stall_periods 3
+
+/**
+ * @brief Counters kept by the distance sensor.
+ */
+struct SensorStats {
+    // samples collected since boot
+    uint32_t samples;
+    // failed measurements since boot (not ready, no valid distance, lost)
+    uint32_t errors;
+    // by sensor_error_t
+    uint32_t error_counts[sensor_error_count];
+    // samples lost or stalls, the sensor's fault rather than the player's
+    uint32_t faults;
+    // time the event queue spent talking to the sensor
+    std::chrono::microseconds busy;
+    // I2C transactions of the samples, their bytes (register indexes and
+    // data) and the time they held the bus
+    uint32_t bus_transactions;
+    uint32_t bus_bytes;
+    std::chrono::microseconds bus_time;
+};
+
+/**
+ * @brief VL53L0X ranging profiles, after ST's table (UM2039). A longer
+ *        timing budget gives fewer samples, with less noise.
+ */
+typedef enum {
+    // 20 ms, for fast moves
+    RANGING_HIGH_SPEED,
+    // 33 ms, as the sensor starts up
+    RANGING_DEFAULT,
+    // 200 ms, for the steadiest readings
+    RANGING_HIGH_ACCURACY
+} ranging_profile_t;
+
+#define ranging_profile_count (RANGING_HIGH_ACCURACY + 1)
+
+// timing budget of each profile in us, back-to-back ranging takes a sample every budget
+static constexpr uint32_t ranging_budget_us[ranging_profile_count] = {20000, 33000, 200000};
+
+/**
+ * @brief The ToF distance sensor, ranging continuously in the background
+ *        while it is started.
+ */
+class DistanceSensor
+{
+public:
+    virtual ~DistanceSensor() = default;
+
+    /**
+     * @brief Start continuous ranging.
+     *        Samples are pushed to samples() when the sensor signals
+     *        they are ready, then on_sample is called on the event loop
+     *        with the time the sample became ready.
+     *
+     * @return 0 (VL53L0X_ERROR_NONE) on success, an error code otherwise.
+     */
+    virtual int start_continuous(void (*on_sample)(uint32_t ready_us)) = 0;
+
+    /**
+     * @brief Stop ranging, no more samples or wakeups until started again.
+     */
+    virtual void stop() = 0;
+
+    /**
+     * @brief Use profile from now on. While ranging, the sensor stops
+     *        and starts again with it, the next sample comes a budget later.
+     *
+     * @return 0 (VL53L0X_ERROR_NONE) on success, an error code otherwise.
+     */
+    virtual int set_profile(ranging_profile_t profile) = 0;
+
+    virtual ranging_profile_t profile() const = 0;
+
+    /**
+     * @brief The ring the samples are pushed to. The sensor is the
+     *        producer, the game the consumer.
+     */
+    virtual SampleRing &samples() = 0;
+
+    /**
+     * @brief The counters, all from the same moment. Safe to call from
+     *        any thread while the sensor collects.
+     */
+    virtual SensorStats stats() = 0;
+};
+
+/**
+ * @brief What an LED shows.
+ */
+typedef enum {
+    LED_OFF,
+    LED_ON,
+    LED_BLINK
+} led_mode_t;
+
+/**
+ * @brief The two LEDs, LED1 being the "not" LED and LED2 the "instruction" LED.
+ *
+ * Blinking runs off a hardware timer, so a pattern costs no CPU time
+ * between transitions and nobody has to wait for it.
+ */
+class Leds
+{
+public:
+    virtual ~Leds() = default;
+
+    /**
+     * @brief Switch to a new pattern. Blinking LEDs start on and
+     *        toggle together every half period.
+     *        Safe to call from interrupt context.
+     */
+    virtual void show(led_mode_t led1, led_mode_t led2, std::chrono::milliseconds half_period) = 0;
+};
+
+/**
+ * @brief The user button.
+ */
+class Button
+{
+public:
+    virtual ~Button() = default;
+
+    /**
+     * @brief Register the handler for when the button is released.
+     *        The handler runs in interrupt context.
+     */
+    virtual void rise(void (*handler)()) = 0;
+};
+
+/**
+ * @brief The NFC tag (M24SR) the player writes their name to.
+ */
+class NfcTag
+{
+public:
+    virtual ~NfcTag() = default;
+
+    /**
+     * @brief Wipe the tag and start watching for phones.
+     *
+     * @param on_session Called in interrupt context with open = true when
+     *                   a phone opens an RF session, and false when it closes
+     *                   it, with the time (Clock::now() in us).
+     * @return 0 on success, negative on failure.
+     */
+    virtual int start(void (*on_session)(bool open, uint32_t time_us)) = 0;
+
+    /**
+     * @brief Read the NDEF message. on_message is called on the event
+     *        loop with the message, or with size 0 if the read failed.
+     */
+    virtual void read(void (*on_message)(const uint8_t *data, size_t size)) = 0;
+
+    /**
+     * @brief Stop watching for phones.
+     */
+    virtual void stop() = 0;
+};
+
+/**
+ * @brief Time source and the one-shot timeout used by the game.
+ */
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+
+    /**
+     * @brief Time elapsed since boot.
+     */
+    virtual std::chrono::microseconds now() = 0;
+
+    /**
+     * @brief Call handler once after delay, replacing any pending timeout.
+     *        Like mbed::Timeout, the handler runs in interrupt context.
+     */
+    virtual void attach(void (*handler)(), std::chrono::microseconds delay) = 0;
+
+    /**
+     * @brief Cancel the pending timeout, if any.
+     */
+    virtual void detach() = 0;
+};
+
+/**
+ * @brief The event loop all the game logic runs on.
+ *        It sleeps until something is posted to it.
+ */
+class EventLoop
+{
+public:
+    virtual ~EventLoop() = default;
+
+    /**
+     * @brief Call handler(event, time_us) on the event loop.
+     *        Safe to call from interrupt context.
+     */
+    virtual void post(void (*handler)(int, uint32_t), int event, uint32_t time_us) = 0;
+};
+
+/**
+ * @brief Where the scores are reported to (the phone, via BLE).
+ *
+ * The updates only mark the telemetry (telemetry.hpp) as changed, the
+ * changes are sent together once the game is done handling the event.
+ */
+class ScoreSink
+{
+public:
+    virtual ~ScoreSink() = default;
+
+    virtual void update_score(uint32_t score) = 0;
+
+    /**
+     * @brief The score went up by a point. verdict_us and shown_us
+     *        (Clock::now() us) are when its verdict was taken and its
+     *        instruction's LEDs written: the latencies from them are
+     *        recorded once the score is written to the GATT server.
+     */
+    virtual void update_point(uint32_t score, uint32_t verdict_us, uint32_t shown_us) = 0;
+
+    virtual void update_high_score(uint32_t high_score) = 0;
+
+    /**
+     * @brief Report the instruction just shown, its time limit and the
+     *        player's reaction time to the previous one.
+     */
+    virtual void update_instruction(int instruction, std::chrono::microseconds rate, uint32_t reaction_us) = 0;
+
+    /**
+     * @brief Publish the latency summary, see pack_latency() in latency.hpp.
+     */
+    virtual void update_latency() = 0;
+};
+
+/**
+ * @brief Console text on its way to the UART, see console_out.hpp.
+ */
+typedef SpscRing<char, 2048> ConsoleRing;
+
+/**
+ * @brief Sends the console text out, at the UART's pace.
+ */
+class ConsoleSink
+{
+public:
+    virtual ~ConsoleSink() = default;
+
+    /**
+     * @brief New text is in ring: start sending it, unless already busy.
+     *        Returns right away, the sink pops the ring as it sends.
+     */
+    virtual void kick(ConsoleRing &ring) = 0;
+};
+
+/**
+ * @brief What the writes to a RecordStore cost the flash.
+ */
+struct StoreStats {
+    // set() calls, and the bytes they asked to store
+    uint32_t sets;
+    uint64_t bytes_set;
+    // bytes programmed and erased for them, including compaction
+    uint64_t bytes_programmed;
+    uint64_t bytes_erased;
+};
+
+/**
+ * @brief Small records kept across resets, in flash.
+ *
+ * set() can block for milliseconds while the flash is programmed or
+ * erased, so the game only calls it while idle.
+ */
+class RecordStore
+{
+public:
+    virtual ~RecordStore() = default;
+
+    /**
+     * @brief Read the record key into buf.
+     *
+     * @param actual Set to the size of the record.
+     * @return 0 on success, negative if there is no such record or the read failed.
+     */
+    virtual int get(const char *key, void *buf, size_t size, size_t *actual) = 0;
+
+    /**
+     * @brief Write (or replace) the record key.
+     *
+     * @return 0 on success, negative on failure.
+     */
+    virtual int set(const char *key, const void *buf, size_t size) = 0;
+
+    virtual StoreStats stats() = 0;
+};
+
+/**
+ * Factory functions that return the devices used by the game.
+ */
+DistanceSensor& get_distance_sensor();
+Leds& get_leds();
+Button& get_button();
+Clock& get_clock();
+EventLoop& get_event_loop();
+ScoreSink& get_score_sink();
+RecordStore& get_record_store();
+ConsoleSink& get_console_sink();
+NfcTag& get_nfc_tag();
+
+#endif
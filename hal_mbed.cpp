@@ -0,0 +1,543 @@
+/**
+ * @file hal_mbed.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief hal.hpp implemented with the B-L475E-IOT01 devices
+ *        declared in initialize.cpp
+ */
+#include "not.hpp"
+#include "FlashIAPBlockDevice.h"
+#include "ProfilingBlockDevice.h"
+#include "TDBStore.h"
+#include "snapshot.hpp"
+
+// created here (rather than on first use) so the GATT service
+// is registered before advertising starts
+GameService game_service{};
+
+/**
+ * @brief The VL53L0X ToF sensor in continuous ranging mode.
+ *
+ * The sensor pulls its GPIO1 line (PC_7) when a sample is ready.
+ * The interrupt only defers the I2C read to the sensor thread, the
+ * highest priority one, so nothing ever waits for a measurement to
+ * complete and nothing the game or the BLE stack does delays a read.
+ * The samples go to the game through the lock-free ring.
+ *
+ * A failed transfer is tried again at once, but never past half a sample
+ * period, so a glitch costs at most the one sample. A sample that is not
+ * read leaves the interrupt set and the sensor silent: after
+ * sensor_stall_periods periods without a sample, a watchdog frees the bus
+ * and starts the sensor over.
+ */
+class MbedDistanceSensor : public DistanceSensor
+{
+public:
+    int start_continuous(void (*on_sample)(uint32_t ready_us)) override;
+
+    void stop() override
+    {
+        // the VL53L0X API is not thread safe, collect() runs on the sensor thread
+        _range_mutex.lock();
+        _running = false;
+        _watchdog.detach();
+        range.stop_measurement(range_continuous_interrupt);
+        _range_mutex.unlock();
+    }
+
+    int set_profile(ranging_profile_t profile) override;
+
+    ranging_profile_t profile() const override { return _profile; }
+
+    SampleRing &samples() override { return _samples; }
+
+    SensorStats stats() override { return _published.read(); }
+
+    /**
+     * @brief Read the ready sample and re-arm the interrupt.
+     *        Runs on the sensor thread.
+     *
+     * @param ready_us When the sensor signalled the sample was ready.
+     */
+    void collect(uint32_t ready_us)
+    {
+        _range_mutex.lock();
+        // data-ready raced with stop()
+        if (!_running) {
+            _range_mutex.unlock();
+            return;
+        }
+
+        std::chrono::microseconds start = get_clock().now();
+        uint16_t distance = 0;
+        int status = range.read_sample(&distance);
+        for (int tries = 1; status < 0; tries++) {
+            _stats.error_counts[SENSOR_ERROR_BUS]++;
+            // the next sample is due a period after this one
+            if (tries == sensor_retries ||
+                (uint32_t)get_clock().now().count() - ready_us >= ranging_budget_us[_profile] / 2)
+                break;
+            status = range.read_sample(&distance);
+        }
+        range.enable_interrupt_measure_detection_irq();
+        arm_watchdog();
+        _range_mutex.unlock();
+
+        if (status == read_sample_valid) {
+            _samples.push({ready_us, distance});
+            _stats.samples++;
+        }
+        else {
+            _stats.errors++;
+            if (status == read_sample_not_ready)
+                _stats.error_counts[SENSOR_ERROR_NOT_READY]++;
+            else if (status == read_sample_invalid)
+                _stats.error_counts[SENSOR_ERROR_RANGE]++;
+            else {
+                _stats.error_counts[SENSOR_ERROR_LOST]++;
+                _stats.faults++;
+            }
+        }
+        _stats.busy += get_clock().now() - start;
+        _stats.bus_transactions = devI2c.transactions();
+        _stats.bus_bytes = devI2c.bytes();
+        _stats.bus_time = devI2c.time();
+        _published.publish(_stats);
+
+        if (status == read_sample_valid)
+            game_worker.call(_on_sample, ready_us);
+    }
+
+    /**
+     * @brief No sample came for sensor_stall_periods periods: free the
+     *        bus, start the sensor over and range again. Runs on the
+     *        sensor thread.
+     */
+    void recover();
+
+private:
+    /**
+     * @brief (Re)start the stall watchdog. Only call holding _range_mutex.
+     */
+    void arm_watchdog();
+
+    SampleRing _samples;
+    void (*_on_sample)(uint32_t ready_us) = nullptr;
+    Mutex _range_mutex;
+    bool _running = false;
+    // init_sensor() leaves the sensor with ST's default settings
+    ranging_profile_t _profile = RANGING_DEFAULT;
+    Timeout _watchdog;
+    // only the sensor thread writes _stats, the others read what it published
+    SensorStats _stats = {};
+    Snapshot<SensorStats> _published;
+};
+
+static MbedDistanceSensor distance_sensor;
+
+static void collect_sample(uint32_t ready_us)
+{
+    distance_sensor.collect(ready_us);
+}
+
+/**
+ * @brief GPIO1 interrupt handler, no I2C allowed in here.
+ */
+static void sample_ready_handler()
+{
+    sensor_worker.call(collect_sample, (uint32_t)get_clock().now().count());
+}
+
+static void recover_sensor()
+{
+    distance_sensor.recover();
+}
+
+/**
+ * @brief Stall watchdog handler, in interrupt context.
+ */
+static void stall_handler()
+{
+    sensor_worker.call(recover_sensor);
+}
+
+void MbedDistanceSensor::arm_watchdog()
+{
+    _watchdog.attach(&stall_handler, std::chrono::microseconds(sensor_stall_periods * ranging_budget_us[_profile]));
+}
+
+int MbedDistanceSensor::start_continuous(void (*on_sample)(uint32_t ready_us))
+{
+    _range_mutex.lock();
+    _on_sample = on_sample;
+    _running = true;
+    int status = range.start_measurement(range_continuous_interrupt, &sample_ready_handler);
+    arm_watchdog();
+    _range_mutex.unlock();
+    return status;
+}
+
+void MbedDistanceSensor::recover()
+{
+    _range_mutex.lock();
+    // a stall watchdog that fired as the ranging stopped
+    if (!_running) {
+        _range_mutex.unlock();
+        return;
+    }
+    _stats.error_counts[SENSOR_ERROR_STALL]++;
+    _stats.faults++;
+
+    // a transfer cut short can leave the sensor holding SDA low
+    range.stop_measurement(range_continuous_interrupt);
+    devI2c.recover_bus();
+    // init_sensor() goes through XSHUT, the sensor starts from its defaults
+    int status = range.init_sensor(sensor_i2c_address);
+    if (status == VL53L0X_ERROR_NONE && _profile != RANGING_DEFAULT)
+        status = range.set_profile(_profile);
+    if (status == VL53L0X_ERROR_NONE)
+        status = range.start_measurement(range_continuous_interrupt, &sample_ready_handler);
+    if (status != VL53L0X_ERROR_NONE)
+        _stats.error_counts[SENSOR_ERROR_RESTART]++;
+    _published.publish(_stats);
+    arm_watchdog();
+    _range_mutex.unlock();
+}
+
+int MbedDistanceSensor::set_profile(ranging_profile_t profile)
+{
+    if (profile == _profile)
+        return VL53L0X_ERROR_NONE;
+
+    // the timing can only change between measurements
+    _range_mutex.lock();
+    if (_running)
+        range.stop_measurement(range_continuous_interrupt);
+    int status = range.set_profile(profile);
+    if (status == VL53L0X_ERROR_NONE)
+        _profile = profile;
+    if (_running) {
+        range.start_measurement(range_continuous_interrupt, &sample_ready_handler);
+        arm_watchdog();
+    }
+    _range_mutex.unlock();
+    return status;
+}
+
+void CountingDevI2C::recover_bus()
+{
+    {
+        // a device stopped in the middle of a byte holds SDA low:
+        // clock the rest of it out, then end with a stop
+        DigitalInOut sda(_sda_pin, PIN_OUTPUT, OpenDrainNoPull, 1);
+        DigitalInOut scl(_scl_pin, PIN_OUTPUT, OpenDrainNoPull, 1);
+        for (int i = 0; i < 9 && sda.read() == 0; i++) {
+            scl = 0;
+            wait_us(5);
+            scl = 1;
+            wait_us(5);
+        }
+        sda = 0;
+        wait_us(5);
+        scl = 1;
+        wait_us(5);
+        sda = 1;
+        wait_us(5);
+    }
+
+    // the pins go back to the I2C peripheral
+    i2c_init(&_i2c, _sda_pin, _scl_pin);
+    frequency(sensor_i2c_hz);
+}
+
+int CountingDevI2C::read_burst(uint8_t address, uint8_t reg, uint8_t *data, uint16_t size)
+{
+    std::chrono::microseconds start = get_clock().now();
+    int status = i2c_read(data, address, reg, size);
+    _time += get_clock().now() - start;
+    _transactions++;
+    _bytes += 1 + size;
+    return status;
+}
+
+int CountingDevI2C::write_register(uint8_t address, uint8_t reg, uint8_t value)
+{
+    std::chrono::microseconds start = get_clock().now();
+    int status = i2c_write(&value, address, reg, 1);
+    _time += get_clock().now() - start;
+    _transactions++;
+    _bytes += 2;
+    return status;
+}
+
+// VL53L0X registers, as in ST's vl53l0x_device.h
+#define reg_system_interrupt_clear 0x0B
+#define reg_result_interrupt_status 0x13
+// RESULT_RANGE_STATUS, then 12 bytes of results, the distance big endian at 10
+#define result_distance_offset 11
+// device range status of a complete, valid measurement
+#define device_range_complete 11
+
+int ProfiledVL53L0X::read_sample(uint16_t *distance)
+{
+    uint8_t result[1 + 12];
+    uint8_t address = _device->I2cDevAddr;
+    if (devI2c.read_burst(address, reg_result_interrupt_status, result, sizeof(result)) != 0)
+        return read_sample_bus_error;
+    if (devI2c.write_register(address, reg_system_interrupt_clear, 0x01) != 0)
+        return read_sample_bus_error;
+
+    *distance = (uint16_t)(result[result_distance_offset] << 8 | result[result_distance_offset + 1]);
+    // bits 0-2: a new sample is ready, bits 3-6 of RESULT_RANGE_STATUS: its status
+    if ((result[0] & 0x07) == 0)
+        return read_sample_not_ready;
+    if (((result[1] & 0x78) >> 3) != device_range_complete)
+        return read_sample_invalid;
+    return read_sample_valid;
+}
+
+int ProfiledVL53L0X::set_profile(ranging_profile_t profile)
+{
+    // ST's sigma limits in mm, the signal rate limit stays at 0.25 MCPS in all three
+    static const uint32_t sigma_limit_mm[ranging_profile_count] = {32, 18, 18};
+
+    int status = vl53l0x_set_limit_check_value(_device, VL53L0X_CHECKENABLE_SIGMA_FINAL_RANGE,
+                                               (FixPoint1616_t)(sigma_limit_mm[profile] << 16));
+    if (status == VL53L0X_ERROR_NONE)
+        status = vl53l0x_set_measurement_timing_budget_micro_seconds(_device, ranging_budget_us[profile]);
+    return status;
+}
+
+/**
+ * @brief LED1 and LED2, blinked by a LowPowerTicker.
+ */
+class MbedLeds : public Leds
+{
+public:
+    void show(led_mode_t mode1, led_mode_t mode2, std::chrono::milliseconds half_period) override
+    {
+        _ticker.detach();
+        _blink1 = mode1 == LED_BLINK;
+        _blink2 = mode2 == LED_BLINK;
+        led1.write(mode1 != LED_OFF);
+        led2.write(mode2 != LED_OFF);
+
+        if (_blink1 || _blink2)
+            _ticker.attach(callback(this, &MbedLeds::toggle), half_period);
+    }
+
+private:
+    /**
+     * @brief Ticker handler, runs in interrupt context.
+     */
+    void toggle()
+    {
+        if (_blink1) led1 = !led1;
+        if (_blink2) led2 = !led2;
+    }
+
+    LowPowerTicker _ticker;
+    bool _blink1 = false;
+    bool _blink2 = false;
+};
+
+/**
+ * @brief The user button.
+ */
+class MbedButton : public Button
+{
+public:
+    void rise(void (*handler)()) override
+    {
+        button.rise(handler);
+    }
+};
+
+/**
+ * @brief The main event queue, dispatched forever on the main thread
+ *        by flappy_init().
+ */
+class MbedEventLoop : public EventLoop
+{
+public:
+    void post(void (*handler)(int, uint32_t), int event, uint32_t time_us) override
+    {
+        game_worker.call(handler, event, time_us);
+    }
+};
+
+/**
+ * @brief Uptime timer and a Timeout.
+ */
+class MbedClock : public Clock
+{
+public:
+    MbedClock() { _uptime.start(); }
+
+    std::chrono::microseconds now() override
+    {
+        return _uptime.elapsed_time();
+    }
+
+    void attach(void (*handler)(), std::chrono::microseconds delay) override
+    {
+        _timeout.attach(handler, delay);
+    }
+
+    void detach() override { _timeout.detach(); }
+
+private:
+    Timer _uptime;
+    Timeout _timeout;
+};
+
+/**
+ * @brief A TDBStore in the internal flash, set "store-address" and
+ *        "store-size" in mbed_app.json to move it.
+ *
+ * The block device is wrapped in a ProfilingBlockDevice, which counts
+ * the bytes that the store programs and erases.
+ */
+class MbedRecordStore : public RecordStore
+{
+public:
+    MbedRecordStore() :
+        _flash(MBED_CONF_APP_STORE_ADDRESS, MBED_CONF_APP_STORE_SIZE),
+        _profile(&_flash),
+        _store(&_profile)
+    { }
+
+    int get(const char *key, void *buf, size_t size, size_t *actual) override
+    {
+        if (!ready()) return MBED_ERROR_NOT_READY;
+        return _store.get(key, buf, size, actual);
+    }
+
+    int set(const char *key, const void *buf, size_t size) override
+    {
+        if (!ready()) return MBED_ERROR_NOT_READY;
+        _sets++;
+        _bytes_set += size;
+        return _store.set(key, buf, size, 0);
+    }
+
+    StoreStats stats() override
+    {
+        return {_sets, _bytes_set, _profile.get_program_count(), _profile.get_erase_count()};
+    }
+
+private:
+    /**
+     * @brief Mount the store on first use.
+     */
+    bool ready()
+    {
+        if (!_initialized) {
+            _initialized = true;
+            _error = _store.init();
+            if (_error)
+                printf("[WARNING] player store failed to mount: %d\n", _error);
+        }
+        return _error == 0;
+    }
+
+    FlashIAPBlockDevice _flash;
+    ProfilingBlockDevice _profile;
+    TDBStore _store;
+    bool _initialized = false;
+    int _error = 0;
+    uint32_t _sets = 0;
+    uint64_t _bytes_set = 0;
+};
+
+/**
+ * @brief Sends the game text from the console thread, the lowest priority
+ *        one, so writing to the UART only ever takes time nobody else wants.
+ *
+ * stdio owns the UART, so the text goes through it rather than a DMA
+ * channel of our own.
+ */
+class MbedConsoleSink : public ConsoleSink
+{
+public:
+    void kick(ConsoleRing &ring) override
+    {
+        _ring = &ring;
+        if (!_sending.exchange(true))
+            console_worker.call(callback(this, &MbedConsoleSink::send));
+    }
+
+private:
+    /**
+     * @brief Write the ring out. Runs on the console thread.
+     */
+    void send()
+    {
+        char chunk[64];
+        for (;;) {
+            size_t size = 0;
+            while (size < sizeof(chunk) && _ring->pop(&chunk[size]))
+                size++;
+            if (size > 0) {
+                fwrite(chunk, 1, size, stdout);
+                continue;
+            }
+
+            fflush(stdout);
+            _sending = false;
+            // text queued after the last pop but before _sending was cleared
+            if (_ring->size() == 0 || _sending.exchange(true))
+                return;
+        }
+    }
+
+    ConsoleRing *_ring = nullptr;
+    std::atomic<bool> _sending{false};
+};
+
+ConsoleSink& get_console_sink()
+{
+    static MbedConsoleSink sink;
+    return sink;
+}
+
+DistanceSensor& get_distance_sensor()
+{
+    return distance_sensor;
+}
+
+Leds& get_leds()
+{
+    static MbedLeds leds;
+    return leds;
+}
+
+Button& get_button()
+{
+    static MbedButton user_button;
+    return user_button;
+}
+
+Clock& get_clock()
+{
+    static MbedClock clock;
+    return clock;
+}
+
+EventLoop& get_event_loop()
+{
+    static MbedEventLoop event_loop;
+    return event_loop;
+}
+
+ScoreSink& get_score_sink()
+{
+    return game_service;
+}
+
+RecordStore& get_record_store()
+{
+    static MbedRecordStore store;
+    return store;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file i2c_timing.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief how long I2C transactions hold the bus, from the bits on the
+ *        wire, and the transactions each ToF sample costs.
+ */
+#ifndef I2C_TIMING_HPP
+#define I2C_TIMING_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// clock of the bus the ToF sensor is on, Fast-mode (the VL53L0X takes up to 400 kHz)
+#define sensor_i2c_hz 400000
+
+/**
+ * @brief One register access.
+ */
+typedef struct {
+    // a read is an index write, a repeated start and the read
+    bool read;
+    // bytes after the register index
+    uint16_t bytes;
+} i2c_transaction_t;
+
+/**
+ * @brief Bits on the wire: a start, the address and index bytes, the
+ *        data bytes, 9 bits each with the ack, and a stop.
+ */
+constexpr uint32_t i2c_bits(const i2c_transaction_t &transaction)
+{
+    return transaction.read ? 1 + 9 * 2 + 1 + 9 * (1 + transaction.bytes) + 1
+                            : 1 + 9 * (2 + transaction.bytes) + 1;
+}
+
+/**
+ * @brief Bus time of transactions at hz, in us, leaving out the time
+ *        the controller takes between them.
+ */
+template <size_t N>
+constexpr uint32_t i2c_time_us(const i2c_transaction_t (&transactions)[N], uint32_t hz)
+{
+    uint64_t bits = 0;
+    for (size_t i = 0; i < N; i++)
+        bits += i2c_bits(transactions[i]);
+    return (uint32_t)((bits * 1000000 + hz - 1) / hz);
+}
+
+/**
+ * @brief Bytes after the addresses: register indexes and data.
+ */
+template <size_t N>
+constexpr uint32_t i2c_bytes(const i2c_transaction_t (&transactions)[N])
+{
+    uint32_t bytes = 0;
+    for (size_t i = 0; i < N; i++)
+        bytes += 1 + transactions[i].bytes;
+    return bytes;
+}
+
+// a sample through ST's VL53L0X_GetRangingMeasurementData() and VL53L0X_ClearInterruptMask()
+static constexpr i2c_transaction_t st_sample_transactions[] = {
+    // the result block, from RESULT_RANGE_STATUS
+    {true, 12},
+    // page 1, the reference signal rate for the signal clip check, page 0
+    {false, 1}, {true, 2}, {false, 1},
+    // SYSTEM_INTERRUPT_CLEAR set and cleared, then RESULT_INTERRUPT_STATUS to check it
+    {false, 1}, {false, 1}, {true, 1}
+};
+
+// a sample through ProfiledVL53L0X::read_sample()
+static constexpr i2c_transaction_t burst_sample_transactions[] = {
+    // RESULT_INTERRUPT_STATUS through the distance, in one burst
+    {true, 13},
+    // SYSTEM_INTERRUPT_CLEAR, the next burst shows whether it took
+    {false, 1}
+};
+
+#endif
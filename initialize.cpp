@@ -12,9 +12,9 @@
 // Initialize ToF device
 // all details please refer to manual:
 // https://www.st.com/resource/en/user_manual/um2153-discovery-kit-for-iot-node-multichannel-communication-with-stm32l4-stmicroelectronics.pdf
-DevI2C devI2c(PB_11, PB_10); 
+CountingDevI2C devI2c(PB_11, PB_10); 
 DigitalOut shutdown_pin(PC_6); 
-VL53L0X range(&devI2c, &shutdown_pin, PC_7); 
+ProfiledVL53L0X range(&devI2c, &shutdown_pin, PC_7); 
 
 // Initialize the user button as interrupt input
 InterruptIn button(BUTTON1);
@@ -27,44 +27,6 @@ EventQueue queue;
 // // game state
 // game_state_t game_state;
 
-/**
- * @brief Interrupt handler for when the button is released.
- */
-void button1_rise_handler()
-{
-    // set printing to true
-    print_flag = true;
-    // update states
-    if (game_state == GAME_INITIALIZED) {
-        game_state = GAME_CALIBRATION_NEAR;
-    } else if (game_state == GAME_CALIBRATION_NEAR_PENDING) {
-        game_state = GAME_CALIBRATION_FAR;
-    } else if (game_state == GAME_CALIBRATION_FAR_PENDING) {
-        game_state = GAME_TUTORIAL;
-    } else if (game_state == GAME_TUTORIAL) {
-        if (tutorial_state == TUTORIAL_START)
-            tutorial_state = TUTORIAL_NEAR;
-        else if (tutorial_state == TUTORIAL_NEAR)
-            tutorial_state = TUTORIAL_FAR;
-        else if (tutorial_state == TUTORIAL_FAR)
-            tutorial_state = TUTORIAL_ALT;
-        else if (tutorial_state == TUTORIAL_ALT)
-            tutorial_state = TUTORIAL_NOT;
-        else if (tutorial_state == TUTORIAL_NOT)
-            tutorial_state = TUTORIAL_PAUSE;
-        else if (tutorial_state == TUTORIAL_PAUSE)
-            tutorial_state = TUTORIAL_GAME_END;
-        else if (tutorial_state == TUTORIAL_GAME_END)
-            game_state = GAME_STARTED;
-    } else if (game_state == GAME_STARTED) {
-        game_state = GAME_PAUSED;
-    } else if (game_state == GAME_PAUSED_PENDING) {
-        game_state = GAME_STARTED;
-    } else if (game_state == GAME_ENDED_PENDING) {
-        game_state = GAME_STARTED;
-    }
-}
-
 /**
  * @brief Extra initialization routines after BLE is done initializing.
  *
@@ -94,26 +56,44 @@ void on_init_complete(BLE::InitializationCompleteCallbackContext *event)
         }
     }
 
-    // Rely on the event queue to advertise the device over BLE
-    queue.call(advertise, &queue);
+    // Rely on the ble thread to advertise the device over BLE
+    ble_worker.call(advertise, &ble_worker.queue());
 }
 
 void schedule_ble_events(BLE::OnEventsToProcessCallbackContext *context)
 {
-    queue.call(Callback<void()>(&context->ble, &BLE::processEvents));
+    // the BLE stack only ever runs on the ble thread, below the game
+    ble_worker.call(Callback<void()>(&context->ble, &BLE::processEvents));
+}
+
+/**
+ * @brief Boot step initializing the ToF sensor, then the game with the
+ *        remembered player. Runs on the game thread, while the BLE
+ *        stack comes up on its own.
+ */
+static void init_sensor_step()
+{
+    // the M24SR has its own I2C object on the bus, at its own clock
+    devI2c.frequency(sensor_i2c_hz);
+    range.init_sensor(sensor_i2c_address);
+    boot_mark(BOOT_SENSOR_READY);
+
+    game_init();
+    game_load_remembered_player();
+    printf("Welcome, *%s*! To play under another name, write it to the NFC tag.\n\n", player_name);
+    console_init();
 }
 
 /**
  * @brief Initialize the ToF sensors and register interrupts.
  *
- * This function raises an assertion error if the sensors
- * cannot be initialized (need to check API again for this).
+ * Nothing waits for the NFC name: the name capture, the BLE stack (and
+ * advertising once it is up) and the ToF sensor all come up as steps on
+ * the event queues. The game starts as the remembered player and switches
+ * when a name is read. Press 'b' on the console for the boot times.
+ * See threads.hpp for which thread runs what.
  */
 bool flappy_init() {
-    assert(read_player_name());
-    printf("Welcome, *%s*!\n\n", player_name.c_str());
-    printf("Please connect your smartphone to the board using bluetooth.\n");
-
     // The BLE class is a singleton
     BLE &ble = BLE::Instance();
     ble.onEventsToProcess(schedule_ble_events);
@@ -129,13 +109,17 @@ bool flappy_init() {
     GapHandler handler;
     auto &gap = ble.gap();
     gap.setEventHandler(&handler);
-    range.init_sensor(0x53);
 
-    button.rise(queue.event(button1_rise_handler));
-    game_state = GAME_INITIALIZED;
-    tutorial_state = TUTORIAL_START;
+    // the BLE events scheduled so far wait in the ble thread's queue
+    threads_start();
+
+    if (!start_name_capture())
+        printf("[WARNING] cannot use the NFC tag, playing as the remembered player\n");
+    queue.call(init_sensor_step);
+    printf("Please connect your smartphone to the board using bluetooth.\n");
 
-    queue.dispatch_forever();
+    // the main thread runs the game
+    game_worker.run();
 
     return true;
-}
\ No newline at end of file
+}
@@ -0,0 +1,67 @@
+/**
+ * @file instructions.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief seedable PRNG and the instruction sequence of a game
+ */
+#include "instructions.hpp"
+
+static uint32_t rotl(uint32_t x, int k)
+{
+    return (x << k) | (x >> (32 - k));
+}
+
+void Xoshiro128::seed(uint32_t seed)
+{
+    // splitmix32
+    for (int i = 0; i < 4; i++) {
+        uint32_t z = (seed += 0x9e3779b9u);
+        z = (z ^ (z >> 16)) * 0x85ebca6bu;
+        z = (z ^ (z >> 13)) * 0xc2b2ae35u;
+        _s[i] = z ^ (z >> 16);
+    }
+}
+
+uint32_t Xoshiro128::next()
+{
+    uint32_t result = rotl(_s[1] * 5, 7) * 9;
+    uint32_t t = _s[1] << 9;
+
+    _s[2] ^= _s[0];
+    _s[3] ^= _s[1];
+    _s[1] ^= _s[2];
+    _s[0] ^= _s[3];
+    _s[2] ^= t;
+    _s[3] = rotl(_s[3], 11);
+    return result;
+}
+
+// "stay still" last, so that the first 5 are the ones always legal
+static const int instruction_choices[] = {0, 1, 2, 10, 11, 12};
+
+int InstructionSequence::draw(int prev)
+{
+    uint32_t legal = (prev == -1 || prev == 2) ? 5 : 6;
+    return instruction_choices[_rng.below(legal)];
+}
+
+void InstructionSequence::start(uint32_t seed)
+{
+    _rng.seed(seed);
+    _seed = seed;
+    _taken = 0;
+    _head = 0;
+    _last = -1;
+    for (int i = 0; i < instruction_lookahead; i++)
+        _buffer[i] = _last = draw(_last);
+}
+
+int InstructionSequence::next()
+{
+    int instruction = _buffer[_head];
+    _buffer[_head] = _last = draw(_last);
+    _head = (_head + 1) % instruction_lookahead;
+    _taken++;
+    return instruction;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file instructions.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief seedable PRNG and the instruction sequence of a game
+ */
+#ifndef INSTRUCTIONS_HPP
+#define INSTRUCTIONS_HPP
+
+#include <cstdint>
+
+// instructions drawn ahead of the one shown
+#define instruction_lookahead 16
+
+/**
+ * @brief xoshiro128** (Blackman & Vigna): 128 bits of state, a few
+ *        32-bit operations per number, and the same numbers from the
+ *        same seed on every platform.
+ */
+class Xoshiro128
+{
+public:
+    explicit Xoshiro128(uint32_t seed = 1) { this->seed(seed); }
+
+    /**
+     * @brief Restart from seed. The state is filled with splitmix32,
+     *        so any seed (0 too) is fine.
+     */
+    void seed(uint32_t seed);
+
+    uint32_t next();
+
+    /**
+     * @brief Uniform in [0, n), in constant time: the high word of
+     *        next() * n, biased by less than n / 2^32.
+     */
+    uint32_t below(uint32_t n) { return (uint32_t)(((uint64_t)next() * n) >> 32); }
+
+private:
+    uint32_t _s[4];
+};
+
+/**
+ * @brief The instructions of one game (see show_lights() for the
+ *        encoding), drawn instruction_lookahead ahead.
+ *
+ * Only legal instructions are drawn: "stay still" (12) is never first
+ * or right after "alternate" (2). Instead of drawing again until the
+ * instruction is legal, the draw is made among the legal ones only, so
+ * every instruction costs one PRNG call. The distribution is the same
+ * as drawing again: uniform over the legal instructions.
+ *
+ * The sequence only depends on the seed, a game can be replayed from it.
+ */
+class InstructionSequence
+{
+public:
+    /**
+     * @brief Start a new game's sequence.
+     */
+    void start(uint32_t seed);
+
+    /**
+     * @brief Take the next instruction, and draw one more in its place.
+     */
+    int next();
+
+    uint32_t seed() const { return _seed; }
+
+    /**
+     * @brief Instructions taken since start().
+     */
+    uint32_t taken() const { return _taken; }
+
+private:
+    /**
+     * @brief Draw the instruction to follow prev (-1 for the first one).
+     */
+    int draw(int prev);
+
+    Xoshiro128 _rng;
+    int _buffer[instruction_lookahead];
+    uint32_t _head = 0;
+    // last instruction drawn, the one at the end of the look-ahead
+    int _last = -1;
+    uint32_t _seed = 0;
+    uint32_t _taken = 0;
+};
+
+#endif
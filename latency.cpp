@@ -0,0 +1,113 @@
+/**
+ * @file latency.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief fixed-bucket latency histograms
+ */
+#include "latency.hpp"
+#include "hal.hpp"
+
+#include <cstdio>
+
+LatencyHistogram latency_histograms[latency_point_count];
+
+static const char *const latency_names[] = {
+    "LED_TO_SAMPLE", "SAMPLE_TO_READ", "TIMEOUT", "TIMEOUT_TO_VERDICT",
+    "SAMPLE_TO_VERDICT", "VERDICT_TO_NOTIFY", "LED_TO_NOTIFY", "DEADLINE_JITTER"
+};
+static_assert(sizeof(latency_names) / sizeof(latency_names[0]) == latency_point_count,
+              "a latency has no name");
+static_assert(latency_sensor_counters == sensor_error_count + 1,
+              "the summary does not hold every sensor error counter");
+
+void LatencyHistogram::add(uint32_t us)
+{
+    int i = us == 0 ? 0 : 32 - __builtin_clz(us);
+    if (i >= latency_buckets)
+        i = latency_buckets - 1;
+
+    _buckets[i]++;
+    _count++;
+    if (us > _max)
+        _max = us;
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < latency_buckets; i++)
+        _buckets[i] = 0;
+    _count = 0;
+    _max = 0;
+}
+
+uint32_t LatencyHistogram::percentile(uint32_t p) const
+{
+    if (_count == 0)
+        return 0;
+
+    // rank of the percentile, rounded up
+    uint32_t rank = (uint64_t(_count) * p + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < latency_buckets - 1; i++) {
+        seen += _buckets[i];
+        if (seen >= rank) {
+            uint32_t upper = bucket_floor(i + 1) - 1;
+            return upper < _max ? upper : _max;
+        }
+    }
+    return _max;
+}
+
+void reset_latency()
+{
+    for (int i = 0; i < latency_point_count; i++)
+        latency_histograms[i].reset();
+}
+
+void print_latency()
+{
+    printf("latency (us)          count      p50      p90      p99      max\n");
+    for (int i = 0; i < latency_point_count; i++) {
+        const LatencyHistogram &h = latency_histograms[i];
+        printf("%-18s %8u %8u %8u %8u %8u\n", latency_names[i], (unsigned)h.count(),
+               (unsigned)h.percentile(50), (unsigned)h.percentile(90),
+               (unsigned)h.percentile(99), (unsigned)h.max());
+    }
+
+    // the non-empty buckets, as "floor:count"
+    for (int i = 0; i < latency_point_count; i++) {
+        const LatencyHistogram &h = latency_histograms[i];
+        if (h.count() == 0)
+            continue;
+
+        printf("%-18s", latency_names[i]);
+        for (int b = 0; b < latency_buckets; b++)
+            if (h.bucket(b) != 0)
+                printf(" %u:%u", (unsigned)LatencyHistogram::bucket_floor(b), (unsigned)h.bucket(b));
+        printf("\n");
+    }
+}
+
+static uint8_t *put_u32(uint8_t *buf, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        *buf++ = value >> (8 * i);
+    return buf;
+}
+
+void pack_latency(uint8_t *buf)
+{
+    for (int i = 0; i < latency_point_count; i++) {
+        const LatencyHistogram &h = latency_histograms[i];
+        buf = put_u32(buf, h.count());
+        buf = put_u32(buf, h.percentile(50));
+        buf = put_u32(buf, h.percentile(99));
+        buf = put_u32(buf, h.max());
+    }
+
+    SensorStats sensor = get_distance_sensor().stats();
+    for (int i = 0; i < sensor_error_count; i++)
+        buf = put_u32(buf, sensor.error_counts[i]);
+    put_u32(buf, sensor.faults);
+}
@@ -0,0 +1,103 @@
+/**
+ * @file latency.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief fixed-bucket latency histograms, from an instruction being
+ *        shown to its score reaching the GATT server
+ */
+#ifndef LATENCY_HPP
+#define LATENCY_HPP
+
+#include <cstdint>
+
+// bucket 0 holds 0 us, bucket i holds [2^(i-1), 2^i) us, the last one everything above
+#define latency_buckets 24
+
+/**
+ * @brief The measured intervals, all in us.
+ */
+typedef enum {
+    // instruction LEDs written -> first sample after it ready
+    LATENCY_LED_TO_SAMPLE,
+    // sample ready (data-ready interrupt) -> read_input()
+    LATENCY_SAMPLE_TO_READ,
+    // deadline -> timeout interrupt
+    LATENCY_TIMEOUT,
+    // timeout interrupt -> verdict
+    LATENCY_TIMEOUT_TO_VERDICT,
+    // sample that followed the instruction ready -> verdict, with early accept
+    LATENCY_SAMPLE_TO_VERDICT,
+    // verdict -> score written to the GATT server
+    LATENCY_VERDICT_TO_NOTIFY,
+    // instruction LEDs written -> score written to the GATT server
+    LATENCY_LED_TO_NOTIFY,
+    // instruction LEDs written + rate -> verdict, when the deadline ended the instruction
+    LATENCY_DEADLINE_JITTER
+} latency_t;
+
+#define latency_point_count (LATENCY_DEADLINE_JITTER + 1)
+
+// count, p50, p99 and max of every histogram, then the distance sensor's
+// error counters (by sensor_error_t, then its faults), as little-endian uint32
+#define latency_summary_size (latency_point_count * 4 * 4 + latency_sensor_counters * 4)
+#define latency_sensor_counters 7
+
+/**
+ * @brief Histogram with power-of-two buckets: O(1) to add to, fixed size.
+ */
+class LatencyHistogram
+{
+public:
+    void add(uint32_t us);
+
+    void reset();
+
+    uint32_t count() const { return _count; }
+
+    uint32_t max() const { return _max; }
+
+    uint32_t bucket(int i) const { return _buckets[i]; }
+
+    /**
+     * @brief Upper bound of the bucket holding the p-th percentile,
+     *        but never above max().
+     */
+    uint32_t percentile(uint32_t p) const;
+
+    /**
+     * @brief Smallest value in bucket i.
+     */
+    static uint32_t bucket_floor(int i) { return i == 0 ? 0 : 1u << (i - 1); }
+
+private:
+    uint32_t _buckets[latency_buckets] = {};
+    uint32_t _count = 0;
+    uint32_t _max = 0;
+};
+
+// only the game thread records, reads and resets them, other threads hand it their intervals
+extern LatencyHistogram latency_histograms[latency_point_count];
+
+inline void latency_record(latency_t which, uint32_t us)
+{
+    latency_histograms[which].add(us);
+}
+
+/**
+ * @brief Forget everything recorded so far.
+ */
+void reset_latency();
+
+/**
+ * @brief Print every histogram, for the serial dump command.
+ */
+void print_latency();
+
+/**
+ * @brief Write the summary of every histogram and the sensor's error
+ *        counters to buf (latency_summary_size bytes), for BLE.
+ */
+void pack_latency(uint8_t *buf);
+
+#endif
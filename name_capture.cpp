@@ -0,0 +1,81 @@
+/**
+ * @file name_capture.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief waits for the player's name on the NFC tag
+ */
+#include "name_capture.hpp"
+#include "boot_times.hpp"
+#include "hal.hpp"
+#include "ndef.hpp"
+
+#include <cstring>
+
+char player_name[player_name_capacity] = "Mario";
+name_capture_stats_t name_capture_stats;
+
+static void (*name_handler)(const char *name) = nullptr;
+// whether player_name was read from the tag, rather than the default
+static bool name_read = false;
+
+/**
+ * @brief Tag read handler, runs on the event loop.
+ */
+static void message_handler(const uint8_t *data, size_t size)
+{
+    // the name is the first UTF-8 Text record, whatever its language
+    // and whatever other records the phone app put around it
+    ndef_view_t text;
+    if (!ndef_find_text(data, size, &text)) {
+        name_capture_stats.ignored++;
+        return;
+    }
+
+    // the tag keeps the last name written, every read finds it again
+    char name[player_name_capacity];
+    ndef_copy_text(text, name, sizeof(name));
+    if (strcmp(name, player_name) == 0 && name_read) {
+        name_capture_stats.ignored++;
+        return;
+    }
+
+    uint32_t now = get_clock().now().count();
+    name_capture_stats.latency_us = name_capture_stats.tap_seen ? now - name_capture_stats.tap_us : 0;
+    // the next name's latency is from its own tap
+    name_capture_stats.tap_seen = false;
+    boot_mark(BOOT_NAME_READ);
+    // the tag stays watched, another player can write their name at any time
+    name_read = true;
+    memcpy(player_name, name, sizeof(name));
+    name_handler(player_name);
+}
+
+static void read_handler(int, uint32_t)
+{
+    name_capture_stats.reads++;
+    get_nfc_tag().read(message_handler);
+}
+
+/**
+ * @brief RF session handler, runs in interrupt context.
+ */
+static void session_handler(bool open, uint32_t time_us)
+{
+    if (open) {
+        name_capture_stats.sessions++;
+        name_capture_stats.tap_seen = true;
+        name_capture_stats.tap_us = time_us;
+    }
+    else {
+        // the phone is done, read what it may have written
+        get_event_loop().post(read_handler, 0, time_us);
+    }
+}
+
+int name_capture_start(void (*on_name)(const char *name))
+{
+    name_handler = on_name;
+    name_capture_stats = {0, 0, 0, false, 0, 0};
+    return get_nfc_tag().start(session_handler);
+}
@@ -0,0 +1,56 @@
+/**
+ * @file name_capture.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief waits for the player's name on the NFC tag
+ */
+#ifndef NAME_CAPTURE_HPP
+#define NAME_CAPTURE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// bytes for the player name, null terminator included; longer names are cut
+#define player_name_capacity 32
+
+/**
+ * @brief How the name got to the board.
+ */
+typedef struct {
+    // RF sessions opened by a phone, and tag reads they triggered
+    uint32_t sessions;
+    uint32_t reads;
+    // reads that found no name on the tag, or the name read before
+    uint32_t ignored;
+    // whether the session that wrote the last name was seen opening
+    bool tap_seen;
+    // when that session opened, Clock::now() us
+    uint32_t tap_us;
+    // from tap_us to the name being recognized, us
+    uint32_t latency_us;
+} name_capture_stats_t;
+
+/**
+ * @brief The player's name, UTF-8 and null terminated.
+ */
+extern char player_name[player_name_capacity];
+
+extern name_capture_stats_t name_capture_stats;
+
+/**
+ * @brief Wait for the player's name on the NFC tag.
+ *
+ * The tag is read after a phone closed an RF session, which is when a
+ * write may have happened; on a board whose GPO line does not signal the
+ * sessions, the tag's fallback poll reads it the same way. The name is the
+ * first UTF-8 Text record of the tag's NDEF message; it is copied to
+ * player_name, then on_name is called, on the event loop, with it. The tag
+ * stays watched: on_name is called again for every new name written, but
+ * not for the same name read again.
+ *
+ * @return 0 on success, or the tag's error.
+ */
+int name_capture_start(void (*on_name)(const char *name));
+
+#endif
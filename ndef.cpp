@@ -0,0 +1,122 @@
+/**
+ * @file ndef.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief NDEF message walker and Text record decoder
+ */
+#include "ndef.hpp"
+
+#include <cstring>
+
+// record header flags, the low 3 bits are the TNF
+#define ndef_flag_mb 0x80
+#define ndef_flag_me 0x40
+#define ndef_flag_cf 0x20
+#define ndef_flag_sr 0x10
+#define ndef_flag_il 0x08
+#define ndef_tnf_mask 0x07
+
+// Text record status byte
+#define ndef_text_utf16 0x80
+#define ndef_text_language_mask 0x3f
+
+bool NdefWalker::next(ndef_record_t *record)
+{
+    if (_done)
+        return false;
+
+    const uint8_t *p = _data + _offset;
+    size_t left = _size - _offset;
+    if (left == 0) {
+        // no ME flag, but nothing left either
+        _done = true;
+        return false;
+    }
+
+    uint8_t flags = p[0];
+    size_t header = 2 + ((flags & ndef_flag_sr) ? 1 : 4) + ((flags & ndef_flag_il) ? 1 : 0);
+    if (left < header) {
+        _done = _malformed = true;
+        return false;
+    }
+
+    size_t type_size = p[1];
+    uint32_t payload_size;
+    size_t i = 2;
+    if (flags & ndef_flag_sr) {
+        payload_size = p[i++];
+    }
+    else {
+        payload_size = (uint32_t)p[i] << 24 | (uint32_t)p[i + 1] << 16 | (uint32_t)p[i + 2] << 8 | p[i + 3];
+        i += 4;
+    }
+    size_t id_size = (flags & ndef_flag_il) ? p[i++] : 0;
+
+    // compared one by one, a 32-bit payload size must not wrap around
+    left -= header;
+    if (type_size > left || id_size > left - type_size || payload_size > left - type_size - id_size) {
+        _done = _malformed = true;
+        return false;
+    }
+
+    record->tnf = (ndef_tnf_t)(flags & ndef_tnf_mask);
+    record->message_begin = flags & ndef_flag_mb;
+    record->message_end = flags & ndef_flag_me;
+    record->chunked = flags & ndef_flag_cf;
+    record->type = {p + header, type_size};
+    record->id = {p + header + type_size, id_size};
+    record->payload = {p + header + type_size + id_size, payload_size};
+
+    _offset += header + type_size + id_size + payload_size;
+    _done = record->message_end;
+    return true;
+}
+
+bool ndef_decode_text(const ndef_record_t &record, ndef_text_t *text)
+{
+    if (record.tnf != NDEF_TNF_WELL_KNOWN || record.chunked ||
+        record.type.size != 1 || record.type.data[0] != 'T' || record.payload.size == 0)
+        return false;
+
+    uint8_t status = record.payload.data[0];
+    size_t language_size = status & ndef_text_language_mask;
+    if (language_size > record.payload.size - 1)
+        return false;
+
+    text->utf16 = status & ndef_text_utf16;
+    text->language = {record.payload.data + 1, language_size};
+    text->text = {record.payload.data + 1 + language_size, record.payload.size - 1 - language_size};
+    return true;
+}
+
+bool ndef_find_text(const uint8_t *data, size_t size, ndef_view_t *text)
+{
+    NdefWalker walker(data, size);
+    ndef_record_t record;
+    ndef_text_t decoded;
+    while (walker.next(&record)) {
+        if (ndef_decode_text(record, &decoded) && !decoded.utf16 && decoded.text.size > 0) {
+            *text = decoded.text;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t ndef_copy_text(const ndef_view_t &text, char *buf, size_t capacity)
+{
+    if (capacity == 0)
+        return 0;
+
+    size_t size = text.size;
+    if (size > capacity - 1) {
+        size = capacity - 1;
+        // back off to the start of the character that got cut
+        while (size > 0 && (text.data[size] & 0xc0) == 0x80)
+            size--;
+    }
+    memcpy(buf, text.data, size);
+    buf[size] = '\0';
+    return size;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file ndef.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief NDEF message walker and Text record decoder.
+ *        Nothing is copied or allocated: records and texts are views
+ *        into the message buffer.
+ */
+#ifndef NDEF_HPP
+#define NDEF_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Type Name Format, how the type of a record is to be read.
+ */
+typedef enum {
+    NDEF_TNF_EMPTY = 0,
+    NDEF_TNF_WELL_KNOWN = 1,
+    NDEF_TNF_MEDIA = 2,
+    NDEF_TNF_ABSOLUTE_URI = 3,
+    NDEF_TNF_EXTERNAL = 4,
+    NDEF_TNF_UNKNOWN = 5,
+    NDEF_TNF_UNCHANGED = 6,
+    NDEF_TNF_RESERVED = 7
+} ndef_tnf_t;
+
+/**
+ * @brief Bytes inside a buffer owned by someone else.
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+} ndef_view_t;
+
+/**
+ * @brief One record of a message.
+ */
+typedef struct {
+    ndef_tnf_t tnf;
+    // MB, ME and CF flags
+    bool message_begin;
+    bool message_end;
+    bool chunked;
+    ndef_view_t type;
+    // empty without the IL flag
+    ndef_view_t id;
+    ndef_view_t payload;
+} ndef_record_t;
+
+/**
+ * @brief A decoded Text record (well-known type "T").
+ */
+typedef struct {
+    // UTF-16 instead of UTF-8
+    bool utf16;
+    // IANA language code, e.g. "en" or "en-US"
+    ndef_view_t language;
+    ndef_view_t text;
+} ndef_text_t;
+
+/**
+ * @brief Walks the records of a message, one header at a time.
+ *
+ * Short (SR) and long records and the optional ID field (IL) are
+ * handled; chunks (CF) are returned as they are. The walk stops after
+ * the record flagged ME, or at the first record that does not fit in
+ * the buffer.
+ */
+class NdefWalker
+{
+public:
+    NdefWalker(const uint8_t *data, size_t size) : _data(data), _size(size) { }
+
+    /**
+     * @brief Decode the next record into record.
+     *
+     * @return false at the end of the message, or if it is malformed.
+     */
+    bool next(ndef_record_t *record);
+
+    /**
+     * @brief Whether the walk stopped on a malformed record.
+     */
+    bool malformed() const { return _malformed; }
+
+private:
+    const uint8_t *_data;
+    size_t _size;
+    size_t _offset = 0;
+    bool _done = false;
+    bool _malformed = false;
+};
+
+/**
+ * @brief Decode the status byte and language of a Text record.
+ *
+ * @return false if record is not a well-formed Text record.
+ */
+bool ndef_decode_text(const ndef_record_t &record, ndef_text_t *text);
+
+/**
+ * @brief Find the first non-empty UTF-8 Text record of a message.
+ *
+ * @return false if there is none.
+ */
+bool ndef_find_text(const uint8_t *data, size_t size, ndef_view_t *text);
+
+/**
+ * @brief Copy UTF-8 text into buf and null terminate it, cutting it to
+ *        at most capacity - 1 bytes without splitting a character.
+ *
+ * @return the number of bytes copied.
+ */
+size_t ndef_copy_text(const ndef_view_t &text, char *buf, size_t capacity);
+
+#endif
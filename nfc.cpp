@@ -14,8 +14,8 @@
 #include "NFCEEPROM.h"
 #include "EEPROMDriver.h"
 
-#include <string>
 #include "not.hpp"
+#include "name_capture.hpp"
 
 using events::EventQueue;
  
@@ -25,39 +25,106 @@ using mbed::Span;
  
 using mbed::nfc::ndef::MessageBuilder;
 
-// player's name
-string player_name = "Mario";
+// our own I2C sessions also move the GPO line, ignore it until this long after them
+#define nfc_settle_time 50ms
 
 /**
- * @brief Player Info reader via NFC
+ * @brief The M24SR tag, read only after a phone closed an RF session.
  *
- * This does include both reading and writing functions.
  * This also requires a phone with a NFC tag reader/writer app installed.
  */
-class PlayerReader : mbed::nfc::NFCEEPROM::Delegate
+class MbedNfcTag : public NfcTag, mbed::nfc::NFCEEPROM::Delegate
 {
 public:
-    PlayerReader(events::EventQueue& queue, NFCEEPROMDriver& eeprom_driver) :
+    MbedNfcTag(events::EventQueue& queue, NFCEEPROMDriver& eeprom_driver) :
         _ndef_buffer(),
         _eeprom(&eeprom_driver, &queue, _ndef_buffer),
-        _queue(queue)
+        _queue(queue),
+        _gpo(MBED_CONF_APP_NFC_GPO_PIN)
     { }
  
-    void run()
+    int start(void (*on_session)(bool open, uint32_t time_us)) override
     {
         if (_eeprom.initialize() != NFC_OK) {
             printf("failed to initialise\r\n");
-            _queue.break_dispatch();
+            return -1;
         }
  
         _eeprom.set_delegate(this);
- 
+        _on_session = on_session;
+
+        i2c_started();
         _queue.call(&_eeprom, &NFCEEPROM::write_ndef_message);
-        _queue.call_every(1500ms, &_eeprom, &NFCEEPROM::read_ndef_message);
+        _gpo.fall(callback(this, &MbedNfcTag::gpo_fall));
+        _gpo.rise(callback(this, &MbedNfcTag::gpo_rise));
+
+        // in case the GPO line is not configured for RF sessions
+        if (MBED_CONF_APP_NFC_FALLBACK_POLL_MS > 0)
+            _poll_id = _queue.call_every(std::chrono::milliseconds(MBED_CONF_APP_NFC_FALLBACK_POLL_MS),
+                                         this, &MbedNfcTag::poll);
+        return 0;
+    }
+
+    void read(void (*on_message)(const uint8_t *data, size_t size)) override
+    {
+        _on_message = on_message;
+        i2c_started();
+        _eeprom.read_ndef_message();
+    }
+
+    void stop() override
+    {
+        _gpo.fall(nullptr);
+        _gpo.rise(nullptr);
+        if (_poll_id != 0)
+            _queue.cancel(_poll_id);
+        _poll_id = 0;
     }
  
 private:
+    void i2c_started()
+    {
+        _i2c_busy = true;
+    }
+
+    void i2c_done()
+    {
+        _i2c_done_at = get_clock().now();
+        _i2c_busy = false;
+    }
+
+    /**
+     * @brief Whether a GPO edge comes from a phone rather than from us.
+     *        Interrupt context.
+     */
+    bool rf_edge()
+    {
+        return !_i2c_busy && get_clock().now() - _i2c_done_at >= nfc_settle_time;
+    }
+
+    void gpo_fall()
+    {
+        if (rf_edge()) _on_session(true, get_clock().now().count());
+    }
+
+    void gpo_rise()
+    {
+        if (rf_edge()) _on_session(false, get_clock().now().count());
+    }
+
+    /**
+     * @brief Fallback poll, on the event queue: do what a session closing
+     *        would, so the read goes through the same handler and is counted.
+     *        Only while the game is idle, a read shares the bus with the sensor.
+     */
+    void poll()
+    {
+        if (!_i2c_busy && _on_session != nullptr && game_idle())
+            _on_session(false, get_clock().now().count());
+    }
+
     virtual void on_ndef_message_written(nfc_err_t result) {
+        i2c_done();
         if (result == NFC_OK) {
             printf("Please tell us your name by sending it to the board via NFC.\r\n");
         } else {
@@ -66,24 +133,14 @@ private:
     }
  
     virtual void on_ndef_message_read(nfc_err_t result) {
-        // if (result == NFC_OK) {
-        //     printf("message read successfully\r\n");
-        // } else {
-        //     printf("failed to read (error: %d)\r\n", result);
-        // }
+        i2c_done();
+        if (result != NFC_OK)
+            _on_message(nullptr, 0);
     }
  
     virtual void parse_ndef_message(const Span<const uint8_t> &buffer) {        
-        if (!buffer.empty()) {
-            // first 7 bytes work as a "header" to indicate the type
-            // i.e. what we're using is a "Text" type
-            // since buffer is already a Span, it's easiest to parse
-            // the actual message component by reading from byte 8
-            Span<const uint8_t> result = buffer.last(buffer.size()-7);
-            std::string s( result.data(), result.data()+result.size() );
-            player_name = s;
-            _queue.break_dispatch();
-        }
+        i2c_done();
+        _on_message(buffer.data(), buffer.size());
     }
  
     virtual size_t build_ndef_message(const Span<uint8_t> &buffer) {
@@ -99,23 +156,35 @@ private:
     uint8_t _ndef_buffer[1024];
     NFCEEPROM _eeprom;
     EventQueue& _queue;
+    InterruptIn _gpo;
+    void (*_on_session)(bool open, uint32_t time_us) = nullptr;
+    void (*_on_message)(const uint8_t *data, size_t size) = nullptr;
+    volatile bool _i2c_busy = false;
+    std::chrono::microseconds _i2c_done_at{0};
+    int _poll_id = 0;
 };
- 
-    
+
+NfcTag& get_nfc_tag()
+{
+    static MbedNfcTag tag(queue, get_eeprom_driver(queue));
+    return tag;
+}
 
 /**
- * @brief reads player name via NFC and stores in player_name.
+ * @brief on_name handler for name_capture_start().
  */
-bool read_player_name()
+static void name_read(const char *name)
 {
-    EventQueue nfc_queue;
-
-    NFCEEPROMDriver& eeprom_driver = get_eeprom_driver(nfc_queue);
- 
-    PlayerReader pr(nfc_queue, eeprom_driver);
- 
-    pr.run();
-    nfc_queue.dispatch_forever();
+    if (name_capture_stats.tap_seen)
+        console_printf(CONSOLE_LOW, "Name read %u ms after the tap (%u tag reads).\n",
+                       (unsigned)(name_capture_stats.latency_us / 1000), (unsigned)name_capture_stats.reads);
+    game_switch_player(name);
+}
 
-    return true;
+/**
+ * @brief Start reading the player name via NFC, in the background.
+ */
+bool start_name_capture()
+{
+    return name_capture_start(name_read) == 0;
 }
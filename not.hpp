@@ -6,77 +6,110 @@
 #include "ble/BLE.h"
 #include "ble/Gap.h"
 #include "VL53L0X.h"
+#include "boot_times.hpp"
+#include "console_out.hpp"
+#include "game.hpp"
+#include "hal.hpp"
+#include "i2c_timing.hpp"
+#include "latency.hpp"
+#include "name_capture.hpp"
+#include "telemetry.hpp"
+#include "threads.hpp"
 
-#define err_value 50
-#define default_near_dist 150
-#define default_far_dist 250
+// 8-bit I2C address the ToF sensor is given at start up
+#define sensor_i2c_address 0x53
 
-/**
- * @brief Whether a new instruction needs to be generated.
- */
-typedef enum {
-    NEW_INSTRUCTION_ON,
-    NEW_INSTRUCTION_OFF,
-    ALTER_INSTRUCTION_ON,
-    END_INSTRUCTION_START,
-    END_INSTRUCTION_ON
-} instruction_state_t;
+// what ProfiledVL53L0X::read_sample() found
+#define read_sample_valid 0
+#define read_sample_not_ready 1
+#define read_sample_invalid 2
+#define read_sample_bus_error -1
 
 /**
- * @brief Whether the data of the tof sensor needs to be read.
+ * @brief The ToF sensor's I2C bus, counting the transactions made
+ *        through read_burst() and write_register() and the bus time
+ *        they take. The ST driver's own accesses (set up, start, stop)
+ *        go through DevI2C and are not counted.
  */
-typedef enum {
-    READ_INPUT_STARTED,
-    READ_INPUT_ON,
-    READ_INPUT_ENDED,
-    READ_INPUT_OFF
-} read_input_state_t;
+class CountingDevI2C : public DevI2C
+{
+public:
+    CountingDevI2C(PinName sda, PinName scl) : DevI2C(sda, scl), _sda_pin(sda), _scl_pin(scl) { }
 
-/**
- * @brief Determine the current game state.
- */
-typedef enum {
-    GAME_INITIALIZED,
-    GAME_CALIBRATION_NEAR,
-    GAME_CALIBRATION_NEAR_PENDING,
-    GAME_CALIBRATION_FAR,
-    GAME_CALIBRATION_FAR_PENDING,
-    GAME_TUTORIAL,
-    GAME_STARTED,
-    GAME_PAUSED,
-    GAME_PAUSED_PENDING,
-    GAME_ENDING,
-    GAME_ENDED,
-    GAME_ENDED_PENDING
-} game_state_t;
+    /**
+     * @brief Free a bus a device holds low, by clocking it by hand,
+     *        and set the peripheral up again. Blocks for about 100 us.
+     */
+    void recover_bus();
+
+    /**
+     * @brief Read size bytes from register reg on, in one transaction.
+     *
+     * @return 0 on success.
+     */
+    int read_burst(uint8_t address, uint8_t reg, uint8_t *data, uint16_t size);
+
+    /**
+     * @brief Write value to register reg, in one transaction.
+     *
+     * @return 0 on success.
+     */
+    int write_register(uint8_t address, uint8_t reg, uint8_t value);
+
+    uint32_t transactions() const { return _transactions; }
+
+    uint32_t bytes() const { return _bytes; }
+
+    std::chrono::microseconds time() const { return _time; }
+
+private:
+    PinName _sda_pin;
+    PinName _scl_pin;
+    uint32_t _transactions = 0;
+    uint32_t _bytes = 0;
+    std::chrono::microseconds _time{0};
+};
 
 /**
- * @brief Determine the current tutorial state.
- *        Essentially an extention of the game state, 
- *        but kept separate for easier use and organization.
+ * @brief The VL53L0X driver, with the timing of the ranging profiles
+ *        (hal.hpp) within reach of the rest of the ST API, and a
+ *        shorter way to a continuous sample.
  */
-typedef enum {
-    TUTORIAL_START,
-    TUTORIAL_NEAR,
-    TUTORIAL_FAR,
-    TUTORIAL_ALT,
-    TUTORIAL_NOT,
-    TUTORIAL_PAUSE,
-    TUTORIAL_GAME_END
-} tutorial_state_t;
+class ProfiledVL53L0X : public VL53L0X
+{
+public:
+    using VL53L0X::VL53L0X;
+
+    /**
+     * @brief Read the ready sample and clear the interrupt, in one burst
+     *        read and one write instead of the seven accesses of
+     *        handle_irq(). The device's own range status says whether it
+     *        is valid; the signal rate limit applies in the device, ST's
+     *        sigma and signal clip checks, done in software, do not.
+     *
+     * @param distance The sample, in mm.
+     *
+     * @return read_sample_valid, or what went wrong.
+     */
+    int read_sample(uint16_t *distance);
+
+    /**
+     * @brief Set the timing budget and sigma limit of profile.
+     *        Only while not ranging.
+     *
+     * @return 0 (VL53L0X_ERROR_NONE) on success, an error code otherwise.
+     */
+    int set_profile(ranging_profile_t profile);
+};
 
 // shared varaibles across files
-extern DevI2C devI2c; 
+extern CountingDevI2C devI2c; 
 extern DigitalOut shutdown_pin; 
-extern VL53L0X range; 
+extern ProfiledVL53L0X range; 
 extern InterruptIn button;
 extern EventQueue queue;
 extern DigitalOut led1;
 extern DigitalOut led2;
-extern game_state_t game_state;
-extern tutorial_state_t tutorial_state;
-extern string player_name;
-extern bool print_flag;
 
 /**
  * @brief A simple listener for some BLE events.
@@ -103,9 +136,15 @@ public:
 /**
  * @brief A BLE game Service.
  *
- * This transmits data to the phone.
+ * This transmits data to the phone. The score, high score and
+ * instruction are packed into one telemetry characteristic, and
+ * at most one notification of it is in flight at a time.
+ *
+ * The update_*() calls come from the game thread, everything that
+ * talks to the GATT server runs on the ble thread. The telemetry and
+ * latency summary go from one to the other through lock-free rings.
  */
-class GameService
+class GameService : public ScoreSink, public GattServer::EventHandler
 {
 public:
     /**
@@ -116,40 +155,127 @@ public:
     /**
      * @brief Update current score.
      */
-    void update_score();
+    void update_score(uint32_t score) override;
 
     /**
-     * @brief Reset current score.
+     * @brief Update current score, after a point.
      */
-    void reset_score();
+    void update_point(uint32_t score, uint32_t verdict_us, uint32_t shown_us) override;
 
     /**
      * @brief Update high score.
      */
-    void update_high_score();
+    void update_high_score(uint32_t high_score) override;
+
+    /**
+     * @brief Update the current instruction.
+     */
+    void update_instruction(int instruction, std::chrono::microseconds rate, uint32_t reaction_us) override;
+
+    /**
+     * @brief Update the latency summary.
+     */
+    void update_latency() override;
+
+    /**
+     * @brief The phone disconnected, no notification is in flight anymore.
+     */
+    void disconnected();
+
+    /**
+     * @brief Called by the GATT server once a notification was sent.
+     */
+    void onDataSent(const GattDataSentCallbackParams &params) override;
 
 private:
     /**
-     * @brief The current score.
+     * @brief The latency summary, as it goes through _latency_channel.
+     */
+    typedef struct {
+        uint8_t bytes[latency_summary_size];
+    } latency_summary_t;
+
+    /**
+     * @brief Schedule a publish() for a telemetry change.
+     *        Runs on the game thread.
+     */
+    void changed();
+
+    /**
+     * @brief Hand the telemetry to the ble thread, once the game is done
+     *        with the event. Runs on the game thread.
+     */
+    void publish();
+
+    /**
+     * @brief Take the newest telemetry from the game thread, and flush it.
+     *        Runs on the ble thread.
+     */
+    void receive();
+
+    /**
+     * @brief Write the telemetry, unless a notification is still in flight.
+     *        Runs on the ble thread.
+     */
+    void flush();
+
+    /**
+     * @brief Write the newest latency summary. Runs on the ble thread.
+     */
+    void write_latency();
+
+    /**
+     * @brief The current score, high score and instruction, on the game thread.
+     */
+    telemetry_t _telemetry;
+
+    /**
+     * @brief Whether a publish() is scheduled.
+     */
+    bool _publish_pending = false;
+
+    /**
+     * @brief From the game thread to the ble thread, a few events' worth.
+     */
+    SpscRing<telemetry_t, 8> _telemetry_channel;
+    SpscRing<latency_summary_t, 2> _latency_channel;
+
+    /**
+     * @brief The newest telemetry on the ble thread, as sent, see pack_telemetry().
      */
-    uint8_t _score;
+    uint8_t _packed[telemetry_size];
 
     /**
-     * @brief The all time high score.
+     * @brief Decides when the telemetry is sent, on the ble thread.
      */
-    uint8_t _high_score;
+    NotifyCoalescer _coalescer;
 
     /**
-     * @brief The GATT Characteristic that communicates the current score.
+     * @brief The last point received on the ble thread that was not written
+     *        yet, see telemetry_t.
      */
-    ReadOnlyGattCharacteristic<uint8_t> _score_characteristic;
+    bool _point_pending = false;
+    uint32_t _point_verdict_us = 0;
+    uint32_t _point_shown_us = 0;
 
     /**
-     * @brief The GATT Characteristic that communicates the high score.
+     * @brief The GATT Characteristic that communicates the telemetry.
      */
-    ReadOnlyGattCharacteristic<uint8_t> _high_score_characteristic;
+    ReadOnlyArrayGattCharacteristic<uint8_t, telemetry_size> _telemetry_characteristic;
+
+    /**
+     * @brief The latency summary, see pack_latency().
+     */
+    uint8_t _latency[latency_summary_size];
+
+    /**
+     * @brief The GATT Characteristic that communicates the latency summary.
+     */
+    ReadOnlyArrayGattCharacteristic<uint8_t, latency_summary_size> _latency_characteristic;
 };
 
+extern GameService game_service;
+
 /**
  * @brief Setup the device by advertising it to other devices.
  *
@@ -168,48 +294,15 @@ void advertise(EventQueue *queue);
 bool flappy_init();
 
 /**
- * @brief User calibration
- */
-void calibrate();
-
-/**
- * @brief Tutorial that's just reading, looking at lights, and pressing button.
- */
-void tutorial();
-
-/**
- * @brief Main game - turn on LED lights according to instruction
- *        and set current instrunction
- */
-void show_lights();
-
-/**
- * @brief Main game - read from ToF sensor.
- *        return the current input if read succeed, or 0 otherwise.
- */
-uint32_t read_input();
-
-/**
- * @brief Main game - analyzes input by comparing reader results
- *        with the current instruction.
- */
-void analyze_input();
-
-/**
- * @brief Main game - main loop.
- *        calls other corresponding functions.
- */
-void main_game();
-
-/**
- * @brief End of game
+ * @brief Listen for commands on the serial console.
  */
-void end_game();
+void console_init();
 
 /**
- * @brief reads player name via NFC and stores in player_name.
+ * @brief Start reading the player name via NFC, in the background.
+ *        When a name is read the game switches to it.
  */
-bool read_player_name();
+bool start_name_capture();
 
 
 #endif
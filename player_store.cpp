@@ -0,0 +1,66 @@
+/**
+ * @file player_store.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief per-player records kept in a RecordStore
+ */
+#include "player_store.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+/**
+ * @brief 32-bit FNV-1a hash.
+ */
+static uint32_t fnv1a(const char *s)
+{
+    uint32_t hash = 2166136261u;
+    while (*s != '\0') {
+        hash ^= (uint8_t)*s++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool PlayerStore::load(const char *name)
+{
+    snprintf(_key, sizeof(_key), "player_%08lx", (unsigned long)fnv1a(name));
+    _dirty = false;
+
+    player_record_t record;
+    size_t actual = 0;
+    if (_store.get(_key, &record, sizeof(record), &actual) == 0 &&
+        actual == sizeof(record) && record.version == player_record_version) {
+        _record = record;
+        return true;
+    }
+
+    _record = {player_record_version, 0, 0, 0, 0, {0, 0, 0}, 0};
+    return false;
+}
+
+int PlayerStore::flush()
+{
+    if (!_dirty)
+        return 0;
+
+    int error = _store.set(_key, &_record, sizeof(_record));
+    if (error == 0)
+        _dirty = false;
+    return error;
+}
+
+int PlayerStore::remember_name(const char *name)
+{
+    return _store.set(last_player_key, name, strlen(name));
+}
+
+bool PlayerStore::remembered_name(char *buf, size_t size)
+{
+    size_t actual = 0;
+    if (size == 0 || _store.get(last_player_key, buf, size - 1, &actual) != 0 || actual == 0)
+        return false;
+    buf[actual < size - 1 ? actual : size - 1] = '\0';
+    return true;
+}
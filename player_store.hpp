@@ -0,0 +1,102 @@
+/**
+ * @file player_store.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief per-player records (high score, games played, calibration)
+ *        kept in a RecordStore across resets
+ */
+#ifndef PLAYER_STORE_HPP
+#define PLAYER_STORE_HPP
+
+#include "difficulty.hpp"
+#include "hal.hpp"
+
+#include <cstdint>
+
+// bump when player_record_t changes, older records are then ignored
+#define player_record_version 3
+// store key of the name of the last player, to play as them at the next boot
+#define last_player_key "last_player"
+
+/**
+ * @brief What is remembered about a player, stored as is.
+ */
+typedef struct {
+    uint32_t version;
+    uint32_t high_score;
+    uint32_t games_played;
+    // calibrated thresholds in mm, 0 if never calibrated
+    uint32_t near_dist;
+    uint32_t far_dist;
+    // reaction estimate, for AdaptiveDifficulty
+    player_skill_t skill;
+    // deviation of the calibration readings in mm, sets the player's margin
+    uint32_t noise_mm;
+} player_record_t;
+
+/**
+ * @brief The current player's record, cached in RAM.
+ *
+ * Changes only mark the record dirty; flush() writes it back with a
+ * single set(), and the game only calls it while idle, so flash never
+ * delays an instruction and a whole game costs at most one write.
+ */
+class PlayerStore
+{
+public:
+    explicit PlayerStore(RecordStore &store) : _store(store) { }
+
+    /**
+     * @brief Load the record of the named player (the NFC player name),
+     *        or start an empty one.
+     *
+     * @return whether a record was found.
+     */
+    bool load(const char *name);
+
+    player_record_t &record() { return _record; }
+
+    /**
+     * @brief The record changed, write it at the next flush().
+     */
+    void changed() { _dirty = true; }
+
+    bool dirty() const { return _dirty; }
+
+    /**
+     * @brief Write the record if it changed. Blocks on the flash.
+     *
+     * @return 0 on success, or the store's error (the record stays dirty).
+     */
+    int flush();
+
+    /**
+     * @brief Remember name as the last player. Blocks on the flash.
+     *
+     * @return 0 on success, or the store's error.
+     */
+    int remember_name(const char *name);
+
+    /**
+     * @brief Read the name given to remember_name() into buf,
+     *        null terminated and cut to size - 1 bytes.
+     *
+     * @return whether there was one.
+     */
+    bool remembered_name(char *buf, size_t size);
+
+    /**
+     * @brief Store key of the current player.
+     */
+    const char *key() const { return _key; }
+
+private:
+    RecordStore &_store;
+    // "player_" and the name's hash in hex, names can hold any character
+    char _key[16] = "";
+    player_record_t _record = {player_record_version, 0, 0, 0, 0, {0, 0, 0}, 0};
+    bool _dirty = false;
+};
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file bench_classifier.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief host benchmark of the per-sample cost of GestureClassifier
+ *
+ * usage: bench_classifier [samples]
+ */
+#include "gesture.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace std::chrono;
+
+int main(int argc, char **argv)
+{
+    uint32_t total = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000000;
+
+    // 3 s read periods at 30 Hz, the hand alternating between 100 and 320 mm
+    const uint32_t period = 90;
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0.0, 3.0);
+    std::vector<uint32_t> stream(total);
+    for (uint32_t i = 0; i < total; i++) {
+        uint32_t mm = (i / 5) % 2 ? 100 : 320;
+        stream[i] = static_cast<uint32_t>(mm + noise(rng));
+    }
+
+    GestureClassifier classifier;
+    classifier.configure(150, 270, 40);
+    uint32_t periods = 0, correct = 0;
+
+    steady_clock::time_point start = steady_clock::now();
+    for (uint32_t i = 0; i < total; i++) {
+        if (i % period == 0) {
+            if (i != 0) {
+                periods++;
+                correct += classifier.verdict(2).correct;
+            }
+            classifier.reset();
+        }
+        classifier.add_sample(stream[i]);
+    }
+    double ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+
+    printf("samples: %u, read periods: %u, alternate verdicts correct: %u\n", total, periods, correct);
+    printf("per sample: %.2f ns\n", ns / total);
+    return correct == periods ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+/**
+ * @file bench_i2c.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief bus time of a ToF sample (i2c_timing.hpp): through ST's
+ *        handle_irq() and through the burst read, at the standard and
+ *        the fast I2C clock, and the share of each ranging profile's
+ *        sample period it holds the bus the M24SR shares.
+ *
+ * usage: bench_i2c
+ *        The times are bits on the wire; on the board, 's' on the
+ *        console prints the measured bus time per sample.
+ */
+#include "hal.hpp"
+#include "i2c_timing.hpp"
+
+#include <cstdio>
+
+template <size_t N>
+static void print_path(const char *name, const i2c_transaction_t (&transactions)[N])
+{
+    uint32_t standard_us = i2c_time_us(transactions, 100000);
+    uint32_t fast_us = i2c_time_us(transactions, sensor_i2c_hz);
+    printf("%-12s %12zu %6u %13u %13u", name, N, i2c_bytes(transactions), standard_us, fast_us);
+    for (int p = 0; p < ranging_profile_count; p++)
+        printf(" %7.2f%%", fast_us * 100.0 / ranging_budget_us[p]);
+    printf("\n");
+}
+
+int main()
+{
+    printf("%-12s %12s %6s %13s %13s %8s %8s %8s\n", "path", "transactions", "bytes",
+           "us @ 100 kHz", "us @ 400 kHz", "speed", "default", "accuracy");
+    print_path("handle_irq", st_sample_transactions);
+    print_path("burst", burst_sample_transactions);
+
+    uint32_t before_us = i2c_time_us(st_sample_transactions, 100000);
+    uint32_t after_us = i2c_time_us(burst_sample_transactions, sensor_i2c_hz);
+    printf("\nbus time per sample: %u us before, %u us after (%.1fx less)\n",
+           before_us, after_us, (double)before_us / after_us);
+    return 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file bench_instructions.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief host benchmark of drawing instructions: InstructionSequence
+ *        against rand() with retries, then checks that the sequence is
+ *        legal, uniform over the legal instructions, and the same for
+ *        the same seed.
+ *
+ * usage: bench_instructions [draws]
+ */
+#include "instructions.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std::chrono;
+
+static volatile int instruction_sink;
+
+/**
+ * @brief What show_lights() did before InstructionSequence.
+ */
+static int legacy_draw(int prev)
+{
+    int instruction = (rand() % 2) * 10 + rand() % 3;
+    while (instruction == 12 && (prev == -1 || prev == 2))
+        instruction = (rand() % 2) * 10 + rand() % 3;
+    return instruction;
+}
+
+static int instruction_index(int instruction)
+{
+    return instruction >= 10 ? instruction - 7 : instruction;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t total = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000000;
+
+    // generation cost
+    InstructionSequence sequence;
+    sequence.start(1);
+    int sum = 0;
+    steady_clock::time_point start = steady_clock::now();
+    for (uint32_t i = 0; i < total; i++)
+        sum += sequence.next();
+    double sequence_ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    instruction_sink = sum;
+
+    srand(1);
+    sum = 0;
+    int prev = -1;
+    start = steady_clock::now();
+    for (uint32_t i = 0; i < total; i++)
+        sum += prev = legacy_draw(prev);
+    double legacy_ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    instruction_sink = sum;
+
+    printf("draws: %u\n", total);
+    printf("per instruction: InstructionSequence %.2f ns, rand() with retries %.2f ns\n",
+           sequence_ns / total, legacy_ns / total);
+
+    // distribution: uniform over the legal instructions, given the previous one
+    // counts[0]: after "alternate" (5 legal), counts[1]: after anything else (6 legal)
+    uint64_t counts[2][6] = {};
+    uint32_t illegal = 0;
+    sequence.start(2);
+    prev = 2;
+    for (uint32_t i = 0; i < total; i++) {
+        int instruction = sequence.next();
+        if (instruction == 12 && prev == 2)
+            illegal++;
+        counts[prev == 2 ? 0 : 1][instruction_index(instruction)]++;
+        prev = instruction;
+    }
+
+    // chi-squared against uniform, critical values at p = 0.001
+    const double critical[2] = {18.47, 20.52};
+    bool uniform = true;
+    for (int c = 0; c < 2; c++) {
+        int legal = c == 0 ? 5 : 6;
+        uint64_t n = 0;
+        for (int i = 0; i < legal; i++)
+            n += counts[c][i];
+        double expected = (double)n / legal, chi2 = 0;
+        for (int i = 0; i < legal; i++)
+            chi2 += (counts[c][i] - expected) * (counts[c][i] - expected) / expected;
+        printf("after %s: %llu draws, chi-squared %.2f (%d dof, critical %.2f)\n",
+               c == 0 ? "alternate" : "the others", (unsigned long long)n, chi2, legal - 1, critical[c]);
+        uniform = uniform && chi2 < critical[c];
+    }
+
+    // the first instruction of a game is never "stay still"
+    uint32_t first_still = 0;
+    for (uint32_t seed = 0; seed < 10000; seed++) {
+        sequence.start(seed);
+        first_still += sequence.next() == 12;
+    }
+
+    // the same seed gives the same sequence
+    InstructionSequence replay;
+    sequence.start(12345);
+    replay.start(12345);
+    bool same = true;
+    for (int i = 0; i < 1000; i++)
+        same = same && sequence.next() == replay.next();
+
+    printf("stay still after alternate: %u, stay still first: %u, replay matches: %s\n",
+           illegal, first_still, same ? "yes" : "no");
+    return illegal == 0 && first_still == 0 && uniform && same ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file bench_ndef.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief host benchmark of getting the player name out of an NDEF
+ *        message: the record walker (ndef.hpp) against the old parse,
+ *        which skipped 7 bytes and built a std::string.
+ *
+ * usage: bench_ndef [iterations] [dump files...]
+ *        dump files hold a raw NDEF message each, as read off the tag;
+ *        without any, the built-in dumps are used.
+ */
+#include "name_capture.hpp"
+#include "ndef.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+static volatile uint32_t checksum_sink;
+
+/**
+ * @brief An NDEF message and the name that should come out of it
+ *        (nullptr for none).
+ */
+struct Dump {
+    std::string label;
+    std::vector<uint8_t> message;
+    const char *expected;
+};
+
+// messages as phone apps write them
+static std::vector<Dump> builtin_dumps()
+{
+    return {
+        // one Text record, "en"
+        {"text_en", {0xd1, 0x01, 0x09, 0x54, 0x02, 0x65, 0x6e, 0x41, 0x6e, 0x67, 0x65, 0x6c, 0x61}, "Angela"},
+        // one Text record, "en-US"
+        {"text_en_us", {0xd1, 0x01, 0x0c, 0x54, 0x05, 0x65, 0x6e, 0x2d, 0x55, 0x53,
+                        0x46, 0x69, 0x6c, 0x6c, 0x69, 0x73}, "Fillis"},
+        // a URI record, then the Text record
+        {"uri_then_text", {0x91, 0x01, 0x16, 0x55, 0x04, 0x67, 0x69, 0x74, 0x68, 0x75, 0x62, 0x2e,
+                           0x63, 0x6f, 0x6d, 0x2f, 0x5a, 0x68, 0x75, 0x6f, 0x7a, 0x69, 0x2d, 0x5a,
+                           0x6f, 0x75, 0x51, 0x01, 0x08, 0x54, 0x02, 0x65, 0x6e, 0x4d, 0x61, 0x72,
+                           0x69, 0x6f}, "Mario"},
+        // long record (4-byte payload length) with an ID
+        {"long_with_id", {0xc9, 0x01, 0x00, 0x00, 0x00, 0x08, 0x01, 0x54, 0x6e, 0x02, 0x65, 0x6e,
+                          0x4c, 0x75, 0x69, 0x67, 0x69}, "Luigi"},
+        // "Zoé", multi-byte UTF-8
+        {"utf8_fr", {0xd1, 0x01, 0x07, 0x54, 0x02, 0x66, 0x72, 0x5a, 0x6f, 0xc3, 0xa9}, "Zo\xc3\xa9"},
+        // UTF-16 text, not taken
+        {"utf16", {0xd1, 0x01, 0x0d, 0x54, 0x82, 0x65, 0x6e, 0x00, 0x50, 0x00, 0x65, 0x00, 0x61,
+                   0x00, 0x63, 0x00, 0x68}, nullptr},
+        // the wiped tag
+        {"empty", {0xd0, 0x00, 0x00}, nullptr},
+        // the payload length runs past the end of the message
+        {"truncated", {0xd1, 0x01, 0x40, 0x54, 0x02, 0x65, 0x6e, 0x41}, nullptr},
+    };
+}
+
+static bool read_dump(const char *path, Dump *dump)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+    uint8_t buf[1024];
+    size_t size = fread(buf, 1, sizeof(buf), file);
+    fclose(file);
+    *dump = {path, std::vector<uint8_t>(buf, buf + size), nullptr};
+    return true;
+}
+
+/**
+ * @brief What the board did before the walker.
+ */
+static bool legacy_parse(const std::vector<uint8_t> &message, std::string *name)
+{
+    if (message.size() <= 7)
+        return false;
+    name->assign(reinterpret_cast<const char *>(message.data()) + 7, message.size() - 7);
+    return true;
+}
+
+static bool walker_parse(const std::vector<uint8_t> &message, char *name)
+{
+    ndef_view_t text;
+    if (!ndef_find_text(message.data(), message.size(), &text))
+        return false;
+    ndef_copy_text(text, name, player_name_capacity);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000000;
+    std::vector<Dump> dumps;
+    for (int i = 2; i < argc; i++) {
+        Dump dump;
+        if (!read_dump(argv[i], &dump)) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+        dumps.push_back(dump);
+    }
+    bool builtin = dumps.empty();
+    if (builtin)
+        dumps = builtin_dumps();
+
+    int wrong = 0;
+    printf("%-16s %5s  %-10s %-10s %10s %10s\n", "dump", "bytes", "walker", "legacy", "walker ns", "legacy ns");
+    for (const Dump &dump : dumps) {
+        char name[player_name_capacity];
+        std::string legacy;
+        bool found = walker_parse(dump.message, name);
+        bool legacy_found = legacy_parse(dump.message, &legacy);
+        if (builtin && (found != (dump.expected != nullptr) || (found && strcmp(name, dump.expected) != 0)))
+            wrong++;
+
+        // the checksum keeps the compiler from dropping the loops
+        uint32_t checksum = 0;
+        steady_clock::time_point start = steady_clock::now();
+        for (uint32_t i = 0; i < iterations; i++)
+            if (walker_parse(dump.message, name))
+                checksum += (uint8_t)name[0];
+        double walker_ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+
+        start = steady_clock::now();
+        for (uint32_t i = 0; i < iterations; i++)
+            if (legacy_parse(dump.message, &legacy))
+                checksum += (uint8_t)legacy[0];
+        double legacy_ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+
+        std::string shown = legacy_found ? legacy : "-";
+        for (char &c : shown)
+            if ((uint8_t)c < 0x20) c = '.';
+        if (shown.size() > 10)
+            shown = shown.substr(0, 8) + "..";
+        printf("%-16s %5zu  %-10s %-10s %10.1f %10.1f\n", dump.label.c_str(), dump.message.size(),
+               found ? name : "-", shown.c_str(), walker_ns / iterations, legacy_ns / iterations);
+        checksum_sink = checksum;
+    }
+
+    if (builtin)
+        printf("\nbuilt-in dumps parsed wrong by the walker: %d\n", wrong);
+    return wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+/**
+ * @file replay_trace.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief judges a recorded game (trace.hpp) again: the samples of every
+ *        instruction go through the classifier, with the thresholds the
+ *        game had or new ones, and the verdicts that come out different
+ *        from the recorded ones are listed.
+ *
+ * usage: replay_trace [--near mm] [--far mm] [--still mm] [-v] file
+ *        file holds a trace as written by sim_flappy --trace, or a
+ *        console log with the output of the 'd' command in it.
+ *        -v lists every instruction, not only the diverging ones.
+ *        Returns 2 if a verdict diverged.
+ */
+#include "gesture.hpp"
+#include "trace.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char *instruction_name(int instruction)
+{
+    switch (instruction) {
+    case 0: return "far";
+    case 1: return "near";
+    case 2: return "alternate";
+    case 10: return "not far";
+    case 11: return "not near";
+    case 12: return "stay still";
+    default: return "?";
+    }
+}
+
+/**
+ * @brief Read a binary trace, or the hex dump between the markers
+ *        print_trace() writes, from anywhere in a console log.
+ */
+static bool read_trace(const char *path, std::vector<uint8_t> *trace)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+    std::string content;
+    char buf[4096];
+    size_t size;
+    while ((size = fread(buf, 1, sizeof(buf), file)) > 0)
+        content.append(buf, size);
+    fclose(file);
+
+    size_t begin = content.rfind("----- trace ");
+    if (begin == std::string::npos) {
+        trace->assign(content.begin(), content.end());
+        return true;
+    }
+
+    size_t end = content.find("----- end of trace -----", begin);
+    if (end == std::string::npos)
+        return false;
+    size_t i = content.find('\n', begin);
+    trace->clear();
+    while (i < end) {
+        if (isxdigit((unsigned char)content[i]) && i + 1 < end && isxdigit((unsigned char)content[i + 1])) {
+            trace->push_back((uint8_t)strtoul(content.substr(i, 2).c_str(), nullptr, 16));
+            i += 2;
+        }
+        else
+            i++;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t near_dist = 0, far_dist = 0, still_range = 0;
+    bool verbose = false;
+    const char *path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--near") == 0 && i + 1 < argc)
+            near_dist = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--far") == 0 && i + 1 < argc)
+            far_dist = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--still") == 0 && i + 1 < argc)
+            still_range = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "-v") == 0)
+            verbose = true;
+        else
+            path = argv[i];
+    }
+    if (path == nullptr) {
+        fprintf(stderr, "usage: replay_trace [--near mm] [--far mm] [--still mm] [-v] file\n");
+        return 1;
+    }
+
+    std::vector<uint8_t> data;
+    if (!read_trace(path, &data)) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return 1;
+    }
+
+    TraceReader reader(data.data(), data.size());
+    trace_record_t record;
+    if (!reader.next(&record) || record.type != TRACE_START || record.version != trace_version) {
+        fprintf(stderr, "%s: not a version %d game trace\n", path, trace_version);
+        return 1;
+    }
+
+    // the game's thresholds, unless replaced
+    uint32_t start_us = record.time_us;
+    bool early_accept = record.early_accept;
+    near_dist = near_dist ? near_dist : record.near_dist;
+    far_dist = far_dist ? far_dist : record.far_dist;
+    still_range = still_range ? still_range : record.still_range;
+    printf("trace: %zu bytes, seed %u, early accept %s\n", data.size(), record.seed,
+           record.early_accept ? "on" : "off");
+    printf("recorded near / far / still: %u / %u / %u mm, replayed: %u / %u / %u mm\n\n",
+           record.near_dist, record.far_dist, record.still_range, near_dist, far_dist, still_range);
+
+    GestureClassifier classifier;
+    classifier.configure(near_dist, far_dist, still_range);
+    int instruction = -1;
+    uint32_t shown_us = 0, rate_us = 0, samples = 0, buttons = 0;
+    uint32_t verdicts = 0, diverging = 0, confidence_changed = 0;
+    uint32_t replayed_right = 0;
+    bool replayed_over = false;
+    bool ended = false;
+    uint32_t score = 0, dropped = 0;
+
+    printf("%9s  %-13s %7s %7s  %-14s %-14s %8s %6s %5s\n",
+           "time (s)", "instruction", "rate ms", "samples", "recorded", "replayed", "distance", "range", "moves");
+    while (reader.next(&record)) {
+        switch (record.type) {
+        case TRACE_INSTRUCTION:
+            instruction = record.instruction;
+            shown_us = record.time_us;
+            rate_us = record.rate_us;
+            samples = 0;
+            classifier.reset();
+            break;
+        case TRACE_SAMPLE:
+            if (instruction != -1) {
+                classifier.add_sample(record.distance);
+                samples++;
+            }
+            break;
+        case TRACE_BUTTON:
+            buttons++;
+            break;
+        case TRACE_VERDICT: {
+            if (instruction == -1)
+                break;
+            verdict_t replayed = classifier.verdict(instruction);
+            bool diverged = replayed.correct != record.verdict.correct;
+            verdicts++;
+            diverging += diverged;
+            confidence_changed += !diverged && replayed.confidence != record.verdict.confidence;
+            // the replayed game ends at its first wrong verdict
+            if (!replayed_over && replayed.correct)
+                replayed_right++;
+            replayed_over = replayed_over || !replayed.correct;
+
+            if (diverged || verbose) {
+                char recorded_text[16], replayed_text[16];
+                snprintf(recorded_text, sizeof(recorded_text), "%s (%u)%s",
+                         record.verdict.correct ? "right" : "wrong", record.verdict.confidence,
+                         record.early ? "*" : "");
+                snprintf(replayed_text, sizeof(replayed_text), "%s (%u)",
+                         replayed.correct ? "right" : "wrong", replayed.confidence);
+                printf("%9.3f  %-13s %7u %7u  %-14s %-14s %8u %6u %5u%s\n",
+                       (shown_us - start_us) / 1e6, instruction_name(instruction), rate_us / 1000, samples,
+                       recorded_text, replayed_text, classifier.distance(), classifier.range(),
+                       classifier.alternations(), diverged ? "  <- diverged" : "");
+            }
+            instruction = -1;
+            break;
+        }
+        case TRACE_END:
+            ended = true;
+            score = record.score;
+            dropped = record.dropped;
+            break;
+        default:
+            break;
+        }
+    }
+
+    printf("\n");
+    if (reader.malformed())
+        printf("[WARNING] the trace is cut short or damaged, replayed up to byte %zu\n", reader.offset());
+    if (dropped)
+        printf("[WARNING] the first %u instructions did not fit in the trace\n", dropped);
+    printf("verdicts: %u, diverging: %u, same verdict with another confidence: %u, button presses: %u\n",
+           verdicts, diverging, confidence_changed, buttons);
+    if (ended)
+        // the dropped instructions were all right, the game went on after them
+        printf("score: recorded %u, replayed %u\n", score, dropped + replayed_right);
+    if (early_accept)
+        printf("(* ended early, on the recorded reaction)\n");
+    return diverging == 0 ? 0 : 2;
+}
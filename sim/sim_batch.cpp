@@ -0,0 +1,549 @@
+/**
+ * @file sim_batch.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief plays many games on the host, on all cores, and reports how the
+ *        scores are spread and what ended the games, to tune the
+ *        difficulty (default_rate, reduce_rate, min_rate, err_value) and
+ *        compare classifier changes without playing by hand.
+ *
+ * The game keeps its state in globals, as on the board, so two games
+ * cannot run in one process: every worker is a forked process playing
+ * its share of the games one after the other in virtual time, and writes
+ * the results into memory shared with the parent. Game i is seeded with
+ * seed + i (instructions, sensor noise, reactions, mistakes) and every
+ * worker calibrates the same way, so the results do not depend on the
+ * number of workers, and two runs can be compared game by game.
+ *
+ * usage: sim_batch [options]
+ *        --games n         games to play (1000)
+ *        --jobs n          worker processes (one per core)
+ *        --seed n          seed of the first game (1)
+ *        --cap n           a game reaching this score ends there (200)
+ *        --default-rate ms, --reduce-rate ms, --min-rate ms, --err mm
+ *                          the difficulty, the game's own by default
+ *        --early           turns on early_accept
+ *        --adaptive        picks the deadlines with AdaptiveDifficulty
+ *        --reaction ms     mean reaction time, normally distributed (250)
+ *        --reaction-sd ms  its standard deviation, never under 100 ms (60)
+ *        --mistake p       chance of a wrong move on each instruction (0.01)
+ *        --half-period ms  time on each side when alternating (150)
+ *        --noise mm        standard deviation of the sensor noise (3)
+ *        --outliers p      share of samples reading 8190 mm (0)
+ *        --glitches p      share of sensor transfers failing (0)
+ *        --wedges p        share of samples wedging the sensor until
+ *                          the stall watchdog starts it over (0)
+ *        --ranging profile range every instruction with speed, default or
+ *                          accuracy instead of the game's pick (auto)
+ *        --csv file        one line per game
+ */
+#include "game.hpp"
+#include "sim_hal.hpp"
+#include "sim_player.hpp"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+using namespace std::chrono_literals;
+
+/**
+ * @brief What ended a game.
+ */
+typedef enum {
+    // the player moved wrong
+    END_MISTAKE,
+    // the player moved only after the deadline
+    END_LATE,
+    // the player moved right and in time, and was judged wrong
+    END_MISJUDGED,
+    // the game reached the score cap
+    END_CAP,
+    // the game did not end in time, virtual time
+    END_STUCK
+} end_cause_t;
+
+#define end_cause_count (END_STUCK + 1)
+
+static const char *const end_cause_names[] = {"mistake", "late", "misjudged", "cap", "stuck"};
+
+/**
+ * @brief One game, as written by the workers.
+ */
+typedef struct {
+    uint32_t seed;
+    uint32_t score;
+    uint8_t cause;
+    // the last instruction, its time limit and the player's reaction to it
+    int8_t instruction;
+    uint16_t rate_ms;
+    uint16_t reaction_ms;
+    // the ranging profile of the last instruction
+    uint8_t profile;
+    // sensor faults during the game, and the instructions they voided
+    uint16_t faults;
+    uint16_t voided;
+    // virtual time from the press to the end
+    uint32_t duration_ms;
+} game_result_t;
+
+static const char *const profile_names[] = {"speed", "default", "accuracy"};
+
+struct BatchConfig {
+    uint32_t games = 1000;
+    uint32_t jobs = 0;
+    uint32_t seed = 1;
+    uint32_t cap = 200;
+    milliseconds default_rate = duration_cast<milliseconds>(::default_rate);
+    milliseconds reduce_rate = duration_cast<milliseconds>(::reduce_rate);
+    milliseconds min_rate = duration_cast<milliseconds>(::min_rate);
+    uint32_t err = default_err_value;
+    bool early = false;
+    bool adaptive = false;
+    double reaction_ms = 250;
+    double reaction_sd_ms = 60;
+    double mistake = 0.01;
+    double half_period_ms = 150;
+    double noise_mm = 3;
+    double outliers = 0;
+    double glitches = 0;
+    double wedges = 0;
+    // a ranging_profile_t, or -1 for the game's pick
+    int ranging = -1;
+    const char *csv = nullptr;
+};
+
+/**
+ * @brief Drives the game of one worker through the simulated devices.
+ */
+class BatchSession
+{
+public:
+    explicit BatchSession(const BatchConfig &config) :
+        _config(config), _player(100, 320, milliseconds(250))
+    { }
+
+    /**
+     * @brief Boot, calibrate and go through the tutorial, up to the press
+     *        that starts the first game.
+     */
+    void warm_up();
+
+    /**
+     * @brief Start a game and play it to the end.
+     */
+    void play(uint32_t seed, game_result_t *result);
+
+private:
+    /**
+     * @brief Move virtual time to the next thing that happens and do it,
+     *        pressing the button if a press is wanted.
+     *
+     * @return false if nothing happens before limit.
+     */
+    bool advance(bool press, microseconds limit);
+
+    void press();
+
+    const BatchConfig &_config;
+    Player _player;
+    microseconds _last_press{-1s};
+};
+
+static const microseconds press_gap = 500ms;
+
+void BatchSession::warm_up()
+{
+    SimDistanceSensor &sensor = sim_distance_sensor();
+    sensor.set_hand([this](microseconds t) { return _player.distance_at(t); });
+    sensor.set_noise(_config.seed, _config.noise_mm);
+    sensor.set_outliers(_config.outliers, 8190);
+    sensor.set_faults(_config.glitches, _config.wedges);
+    _player.set_half_period(duration_cast<microseconds>(duration<double, std::milli>(_config.half_period_ms)));
+
+    game_init();
+    game_load_remembered_player();
+    game_post(EVENT_CONNECTED);
+
+    const microseconds limit = 600s;
+    for (;;) {
+        sim_event_loop().run();
+        if (game_state == GAME_TUTORIAL && tutorial_state == TUTORIAL_GAME_END)
+            return;
+        bool waiting = game_state == GAME_INITIALIZED ||
+                       game_state == GAME_CALIBRATION_NEAR_PENDING ||
+                       game_state == GAME_CALIBRATION_FAR_PENDING ||
+                       game_state == GAME_TUTORIAL;
+        if (!advance(waiting, limit))
+            return;
+    }
+}
+
+void BatchSession::play(uint32_t seed, game_result_t *result)
+{
+    SimClock &clock = sim_clock();
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> reaction_ms(_config.reaction_ms, _config.reaction_sd_ms);
+    std::bernoulli_distribution mistake(_config.mistake);
+
+    // every game is a new player, nothing is known of their reactions
+    char name[16];
+    snprintf(name, sizeof(name), "player %u", seed);
+    game_load_player(name);
+
+    // seed 0 would take the seed from the clock
+    instruction_seed = seed != 0 ? seed : UINT32_MAX;
+    sim_distance_sensor().set_noise(seed, _config.noise_mm);
+
+    *result = {seed, 0, END_STUCK, -1, 0, 0, RANGING_DEFAULT, 0, 0, 0};
+    uint32_t faults = get_distance_sensor().stats().faults;
+    uint32_t voided = voided_windows;
+    microseconds start = clock.now();
+    microseconds limit = start + (_config.cap + 2) * _config.default_rate + 60s;
+    uint32_t attach_seen = clock.attach_count();
+    uint32_t shown = 0;
+    bool started = false;
+
+    for (;;) {
+        sim_event_loop().run();
+
+        // a new instruction attaches a new read timeout
+        if (clock.attach_count() != attach_seen) {
+            attach_seen = clock.attach_count();
+            if (game_state == GAME_STARTED) {
+                if (!started)
+                    start = clock.now();
+                started = true;
+                microseconds reaction = duration_cast<microseconds>(
+                    duration<double, std::milli>(std::max(100.0, reaction_ms(rng))));
+                // with early accept, a wrong move can come too late to count:
+                // the hand may already be where the instruction wants it
+                bool capped = shown >= _config.cap;
+                bool wrong_move = capped || mistake(rng);
+                _player.set_reaction(reaction);
+                _player.respond(instruction, clock.now(), wrong_move);
+
+                result->cause = capped ? END_CAP : wrong_move ? END_MISTAKE :
+                                instruction != 12 && reaction >= rate ? END_LATE : END_MISJUDGED;
+                result->instruction = (int8_t)instruction;
+                result->rate_ms = (uint16_t)duration_cast<milliseconds>(rate).count();
+                result->reaction_ms = (uint16_t)duration_cast<milliseconds>(reaction).count();
+                result->profile = (uint8_t)sim_distance_sensor().profile();
+                shown++;
+            }
+        }
+
+        if (started && game_state == GAME_ENDED_PENDING)
+            break;
+        bool waiting = !started && (game_state == GAME_TUTORIAL || game_state == GAME_ENDED_PENDING);
+        if (!advance(waiting, limit)) {
+            result->cause = END_STUCK;
+            break;
+        }
+    }
+    result->score = sim_score_sink().score();
+    result->faults = (uint16_t)std::min<uint32_t>(UINT16_MAX, get_distance_sensor().stats().faults - faults);
+    result->voided = (uint16_t)std::min<uint32_t>(UINT16_MAX, voided_windows - voided);
+    result->duration_ms = (uint32_t)duration_cast<milliseconds>(clock.now() - start).count();
+}
+
+bool BatchSession::advance(bool want_press, microseconds limit)
+{
+    SimClock &clock = sim_clock();
+    SimDistanceSensor &sensor = sim_distance_sensor();
+    SimScoreSink &sink = sim_score_sink();
+
+    microseconds next = limit, t;
+    if (want_press)
+        next = std::max(clock.now(), _last_press + press_gap);
+    if (clock.deadline(&t))
+        next = std::min(next, t);
+    if (sensor.next_sample(&t))
+        next = std::min(next, t);
+    if (sink.next_connection_event(&t))
+        next = std::min(next, t);
+    if (next >= limit)
+        return false;
+
+    clock.advance_to(std::max(next, clock.now()));
+    if (want_press && clock.now() - _last_press >= press_gap)
+        press();
+    sensor.collect();
+    if (sink.next_connection_event(&t) && t <= clock.now())
+        sink.connection_event();
+    sim_console_sink().update();
+    return true;
+}
+
+void BatchSession::press()
+{
+    microseconds now = sim_clock().now();
+    // near, then far for the calibration; every game starts far
+    if (game_state == GAME_INITIALIZED)
+        _player.hold(_player.near_mm(), now, now);
+    else
+        _player.hold(_player.far_mm(), now, now);
+    sim_button().press();
+    _last_press = now;
+}
+
+static void run_worker(const BatchConfig &config, uint32_t worker, game_result_t *results,
+                       ranging_stats_t *worker_ranging)
+{
+    // the game's own text is of no use here
+    if (freopen("/dev/null", "w", stdout) == nullptr)
+        _exit(1);
+
+    default_rate = config.default_rate;
+    reduce_rate = config.reduce_rate;
+    min_rate = config.min_rate;
+    rate = default_rate;
+    err_value = config.err;
+    early_accept = config.early;
+    if (config.adaptive)
+        difficulty = &adaptive_difficulty;
+    if (config.ranging >= 0) {
+        auto_ranging = false;
+        sim_distance_sensor().set_profile((ranging_profile_t)config.ranging);
+    }
+
+    BatchSession session(config);
+    session.warm_up();
+    for (uint32_t i = worker; i < config.games; i += config.jobs)
+        session.play(config.seed + i, &results[i]);
+    std::copy(ranging_stats, ranging_stats + ranging_profile_count, worker_ranging);
+}
+
+static const char *instruction_name(int instruction)
+{
+    switch (instruction) {
+    case 0: return "far";
+    case 1: return "near";
+    case 2: return "alternate";
+    case 10: return "not far";
+    case 11: return "not near";
+    case 12: return "stay still";
+    default: return "?";
+    }
+}
+
+static void print_report(const BatchConfig &config, const game_result_t *results,
+                         const ranging_stats_t *worker_ranging, double wall_s)
+{
+    std::vector<uint32_t> scores;
+    uint32_t causes[end_cause_count] = {};
+    uint64_t virtual_ms = 0;
+    uint64_t faults = 0, voided = 0;
+    double sum = 0, sum_sq = 0;
+    for (uint32_t i = 0; i < config.games; i++) {
+        scores.push_back(results[i].score);
+        causes[results[i].cause]++;
+        virtual_ms += results[i].duration_ms;
+        faults += results[i].faults;
+        voided += results[i].voided;
+        sum += results[i].score;
+        sum_sq += (double)results[i].score * results[i].score;
+    }
+    std::sort(scores.begin(), scores.end());
+    double n = config.games;
+    double mean = sum / n;
+    double sd = n > 1 ? sqrt(std::max(0.0, (sum_sq - sum * mean) / (n - 1))) : 0;
+    auto percentile = [&](double p) { return scores[std::min<size_t>(scores.size() - 1, (size_t)(p * n))]; };
+
+    printf("games: %u on %u workers in %.2f s (%.0f games/s), %.1f h of play in virtual time\n",
+           config.games, config.jobs, wall_s, n / wall_s, virtual_ms / 3.6e6);
+    printf("difficulty: %s, %lld ms, %lld ms shorter each instruction, at least %lld ms, err %u mm, early accept %s\n",
+           config.adaptive ? "adaptive" : "linear", (long long)config.default_rate.count(),
+           (long long)config.reduce_rate.count(), (long long)config.min_rate.count(), config.err,
+           config.early ? "on" : "off");
+    printf("player: reaction %.0f +- %.0f ms, mistakes %.1f%%, alternating every %.0f ms, "
+           "noise %.1f mm, outliers %.1f%%\n",
+           config.reaction_ms, config.reaction_sd_ms, config.mistake * 100, config.half_period_ms,
+           config.noise_mm, config.outliers * 100);
+    printf("ranging: %s, transfers failing %.2f%%, samples wedging the sensor %.2f%%\n\n",
+           config.ranging < 0 ? "auto" : profile_names[config.ranging], config.glitches * 100, config.wedges * 100);
+
+    printf("score: mean %.1f +- %.1f (95%% CI), p10 %u, median %u, p90 %u, max %u\n",
+           mean, 1.96 * sd / sqrt(n), percentile(0.1), percentile(0.5), percentile(0.9), scores.back());
+    uint32_t width = std::max(1u, (config.cap + 9) / 10);
+    uint32_t buckets[11] = {}, most = 1;
+    for (uint32_t score : scores) {
+        uint32_t &bucket = buckets[std::min(10u, score / width)];
+        most = std::max(most, ++bucket);
+    }
+    for (uint32_t b = 0; b <= 10 && b * width <= config.cap; b++)
+        printf("  %4u-%-4u %6u %s\n", b * width, b * width + width - 1, buckets[b],
+               std::string(buckets[b] * 40 / most, '#').c_str());
+
+    printf("\nwhat ended the games:\n");
+    for (int c = 0; c < end_cause_count; c++)
+        printf("  %-10s %6u %5.1f%%\n", end_cause_names[c], causes[c], causes[c] * 100 / n);
+    // a sensor fault never ends a game, the instruction it spoilt is not judged
+    printf("sensor faults: %llu, instructions not judged: %llu\n",
+           (unsigned long long)faults, (unsigned long long)voided);
+
+    // the ones to look at when tuning: games lost although the player did it right
+    static const int instructions[] = {0, 1, 2, 10, 11, 12};
+    printf("\nmisjudged / late, by instruction:\n");
+    for (int instr : instructions) {
+        uint32_t misjudged = 0, late = 0;
+        for (uint32_t i = 0; i < config.games; i++) {
+            misjudged += results[i].instruction == instr && results[i].cause == END_MISJUDGED;
+            late += results[i].instruction == instr && results[i].cause == END_LATE;
+        }
+        printf("  %-10s %6u / %u\n", instruction_name(instr), misjudged, late);
+    }
+
+    // the noise is the simulated sensor's, see SimDistanceSensor::set_noise()
+    printf("\nranging profiles:\n");
+    printf("  %-10s %6s %9s %9s %10s %9s\n", "profile", "budget", "periods", "samples/s", "noise (mm)", "misjudged");
+    for (int p = 0; p < ranging_profile_count; p++) {
+        ranging_stats_t total = {0, 0, 0, 0};
+        for (uint32_t w = 0; w < config.jobs; w++) {
+            const ranging_stats_t &stats = worker_ranging[w * ranging_profile_count + p];
+            total.windows += stats.windows;
+            total.samples += stats.samples;
+            total.time_us += stats.time_us;
+        }
+        uint32_t misjudged = 0;
+        for (uint32_t i = 0; i < config.games; i++)
+            misjudged += results[i].profile == p && results[i].cause == END_MISJUDGED;
+        printf("  %-10s %4u ms %9u %9.1f %10.1f %9u\n", profile_names[p], ranging_budget_us[p] / 1000,
+               total.windows, total.time_us ? total.samples * 1e6 / total.time_us : 0.0,
+               config.noise_mm * sqrt((double)ranging_budget_us[RANGING_DEFAULT] / ranging_budget_us[p]),
+               misjudged);
+    }
+}
+
+static bool write_csv(const char *path, const BatchConfig &config, const game_result_t *results)
+{
+    FILE *file = fopen(path, "w");
+    if (file == nullptr)
+        return false;
+    fprintf(file, "seed,score,end,instruction,rate_ms,reaction_ms,profile,faults,voided,duration_ms\n");
+    for (uint32_t i = 0; i < config.games; i++) {
+        const game_result_t &r = results[i];
+        fprintf(file, "%u,%u,%s,%d,%u,%u,%s,%u,%u,%u\n", r.seed, r.score, end_cause_names[r.cause],
+                r.instruction, r.rate_ms, r.reaction_ms, profile_names[r.profile], r.faults, r.voided,
+                r.duration_ms);
+    }
+    return fclose(file) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    BatchConfig config;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--early") == 0) {
+            config.early = true;
+            continue;
+        }
+        if (strcmp(arg, "--adaptive") == 0) {
+            config.adaptive = true;
+            continue;
+        }
+        if (value == nullptr) {
+            fprintf(stderr, "%s: missing value\n", arg);
+            return 1;
+        }
+        i++;
+        if (strcmp(arg, "--games") == 0) config.games = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--jobs") == 0) config.jobs = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--seed") == 0) config.seed = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--cap") == 0) config.cap = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--default-rate") == 0) config.default_rate = milliseconds(strtoul(value, nullptr, 10));
+        else if (strcmp(arg, "--reduce-rate") == 0) config.reduce_rate = milliseconds(strtoul(value, nullptr, 10));
+        else if (strcmp(arg, "--min-rate") == 0) config.min_rate = milliseconds(strtoul(value, nullptr, 10));
+        else if (strcmp(arg, "--err") == 0) config.err = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--reaction") == 0) config.reaction_ms = atof(value);
+        else if (strcmp(arg, "--reaction-sd") == 0) config.reaction_sd_ms = atof(value);
+        else if (strcmp(arg, "--mistake") == 0) config.mistake = atof(value);
+        else if (strcmp(arg, "--half-period") == 0) config.half_period_ms = atof(value);
+        else if (strcmp(arg, "--noise") == 0) config.noise_mm = atof(value);
+        else if (strcmp(arg, "--outliers") == 0) config.outliers = atof(value);
+        else if (strcmp(arg, "--glitches") == 0) config.glitches = atof(value);
+        else if (strcmp(arg, "--wedges") == 0) config.wedges = atof(value);
+        else if (strcmp(arg, "--ranging") == 0) {
+            config.ranging = -1;
+            for (int p = 0; p < ranging_profile_count; p++)
+                if (strcmp(value, profile_names[p]) == 0)
+                    config.ranging = p;
+            if (config.ranging < 0 && strcmp(value, "auto") != 0) {
+                fprintf(stderr, "unknown ranging profile %s\n", value);
+                return 1;
+            }
+        }
+        else if (strcmp(arg, "--csv") == 0) config.csv = value;
+        else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 1;
+        }
+    }
+    if (config.games == 0) {
+        fprintf(stderr, "no games to play\n");
+        return 1;
+    }
+    if (config.jobs == 0)
+        config.jobs = std::max(1u, std::thread::hardware_concurrency());
+    config.jobs = std::min(config.jobs, config.games);
+
+    // the results, then the ranging counters of every worker
+    size_t results_size = (config.games * sizeof(game_result_t) + 7) / 8 * 8;
+    size_t size = results_size + config.jobs * ranging_profile_count * sizeof(ranging_stats_t);
+    void *shared = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    game_result_t *results = static_cast<game_result_t *>(shared);
+    ranging_stats_t *worker_ranging = reinterpret_cast<ranging_stats_t *>(static_cast<char *>(shared) + results_size);
+
+    steady_clock::time_point wall_start = steady_clock::now();
+    fflush(stdout);
+    std::vector<pid_t> workers;
+    for (uint32_t w = 0; w < config.jobs; w++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return 1;
+        }
+        if (pid == 0) {
+            run_worker(config, w, results, worker_ranging + w * ranging_profile_count);
+            _exit(0);
+        }
+        workers.push_back(pid);
+    }
+
+    bool failed = false;
+    for (pid_t pid : workers) {
+        int status;
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = true;
+    }
+    double wall_s = duration_cast<duration<double>>(steady_clock::now() - wall_start).count();
+    if (failed) {
+        fprintf(stderr, "a worker failed\n");
+        return 1;
+    }
+
+    print_report(config, results, worker_ranging, wall_s);
+    if (config.csv != nullptr && !write_csv(config.csv, config, results)) {
+        fprintf(stderr, "cannot write %s\n", config.csv);
+        return 1;
+    }
+    return 0;
+}
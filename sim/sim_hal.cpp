@@ -0,0 +1,507 @@
+/**
+ * @file sim_hal.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief hal.hpp implemented with simulated devices
+ */
+#include "sim_hal.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+void SimClock::attach(void (*handler)(), std::chrono::microseconds delay)
+{
+    _handler = handler;
+    _deadline = _now + delay;
+    _attach_count++;
+}
+
+bool SimClock::deadline(std::chrono::microseconds *t) const
+{
+    if (_handler == nullptr) return false;
+    *t = _deadline;
+    return true;
+}
+
+void SimClock::advance_to(std::chrono::microseconds t)
+{
+    while (_handler != nullptr && _deadline <= t) {
+        void (*handler)() = _handler;
+        _handler = nullptr;
+        _now = _deadline;
+        handler();
+    }
+    if (t > _now)
+        _now = t;
+}
+
+int SimDistanceSensor::start_continuous(void (*on_sample)(uint32_t ready_us))
+{
+    _on_sample = on_sample;
+    _running = true;
+    _next_sample = sim_clock().now() + _budget;
+    return 0;
+}
+
+bool SimDistanceSensor::next_sample(std::chrono::microseconds *t) const
+{
+    if (!_running) return false;
+    *t = _next_sample;
+    return true;
+}
+
+void SimDistanceSensor::collect()
+{
+    SimClock &clock = sim_clock();
+
+    while (_running && _next_sample <= clock.now()) {
+        std::chrono::microseconds ready = _next_sample;
+        uint32_t ready_us = static_cast<uint32_t>(ready.count());
+        if (_wedge.p() > 0 && _wedge(_rng)) {
+            // silent until the watchdog fires and the sensor is started over
+            _stats.error_counts[SENSOR_ERROR_STALL]++;
+            _stats.faults++;
+            _next_sample += sensor_stall_periods * _budget + sim_sensor_restart + _budget;
+            continue;
+        }
+
+        // the tries MbedDistanceSensor::collect() makes
+        int tries = 1;
+        bool read = !(_glitch.p() > 0 && _glitch(_rng));
+        while (!read) {
+            _stats.error_counts[SENSOR_ERROR_BUS]++;
+            if (tries == sensor_retries || tries * _transfer >= _budget / 2)
+                break;
+            tries++;
+            read = !_glitch(_rng);
+        }
+        std::chrono::microseconds busy = tries * _transfer;
+        _stats.busy += busy;
+        _stats.bus_transactions += tries * sizeof(burst_sample_transactions) / sizeof(burst_sample_transactions[0]);
+        _stats.bus_bytes += tries * i2c_bytes(burst_sample_transactions);
+        _stats.bus_time += busy;
+        _next_sample += _budget;
+        clock.advance_to(clock.now() + busy);
+        if (!read) {
+            _stats.errors++;
+            _stats.error_counts[SENSOR_ERROR_LOST]++;
+            _stats.faults++;
+            continue;
+        }
+
+        double mm = _hand ? _hand(ready) : 0;
+        mm += _noise(_rng);
+        if (_outlier.p() > 0 && _outlier(_rng))
+            mm = _outlier_mm;
+        _samples.push({ready_us, mm < 1 ? 1 : static_cast<uint32_t>(mm)});
+        _stats.samples++;
+
+        if (_on_sample != nullptr)
+            _on_sample(ready_us);
+    }
+}
+
+int SimDistanceSensor::set_profile(ranging_profile_t profile)
+{
+    _profile = profile;
+    _budget = std::chrono::microseconds(ranging_budget_us[profile]);
+    scale_noise();
+    // the measurement under way is dropped
+    if (_running)
+        _next_sample = sim_clock().now() + _budget;
+    return 0;
+}
+
+void SimDistanceSensor::set_noise(uint32_t seed, double sigma_mm)
+{
+    _rng.seed(seed);
+    _sigma_mm = sigma_mm;
+    scale_noise();
+}
+
+void SimDistanceSensor::scale_noise()
+{
+    double scale = std::sqrt((double)ranging_budget_us[RANGING_DEFAULT] / ranging_budget_us[_profile]);
+    _noise = std::normal_distribution<double>(0.0, _sigma_mm * scale);
+}
+
+void SimDistanceSensor::set_outliers(double probability, uint32_t mm)
+{
+    _outlier = std::bernoulli_distribution(probability);
+    _outlier_mm = mm;
+}
+
+void SimDistanceSensor::set_faults(double glitch_probability, double wedge_probability)
+{
+    _glitch = std::bernoulli_distribution(glitch_probability);
+    _wedge = std::bernoulli_distribution(wedge_probability);
+}
+
+void SimLeds::show(led_mode_t led1, led_mode_t led2, std::chrono::milliseconds half_period)
+{
+    _modes[0] = led1;
+    _modes[1] = led2;
+    _half_period = half_period;
+    _since = sim_clock().now();
+    _patterns++;
+}
+
+int SimLeds::read(int led) const
+{
+    led_mode_t mode = _modes[led == 1 ? 0 : 1];
+    if (mode != LED_BLINK)
+        return mode == LED_ON;
+    // blinking LEDs start on
+    return (sim_clock().now() - _since) / _half_period % 2 == 0;
+}
+
+void SimButton::press()
+{
+    if (_handler != nullptr)
+        _handler();
+}
+
+void SimEventLoop::post(void (*handler)(int, uint32_t), int event, uint32_t time_us)
+{
+    _posted.push_back({handler, event, time_us});
+}
+
+uint32_t SimEventLoop::run()
+{
+    uint32_t count = 0;
+    while (!_posted.empty()) {
+        Posted posted = _posted.front();
+        _posted.pop_front();
+        posted.handler(posted.event, posted.time_us);
+        count++;
+    }
+    return count;
+}
+
+static void flush_score_sink(int, uint32_t)
+{
+    sim_score_sink().flush();
+}
+
+/**
+ * @brief Schedule a flush after the event being handled, as GameService::changed().
+ */
+static void telemetry_changed(NotifyCoalescer &coalescer)
+{
+    if (coalescer.changed())
+        sim_event_loop().post(flush_score_sink, 0, 0);
+}
+
+void SimScoreSink::update_score(uint32_t score)
+{
+    _telemetry.score = score;
+    telemetry_changed(_coalescer);
+}
+
+void SimScoreSink::update_point(uint32_t score, uint32_t verdict_us, uint32_t shown_us)
+{
+    _telemetry.score = score;
+    _telemetry.point = true;
+    _telemetry.verdict_us = verdict_us;
+    _telemetry.shown_us = shown_us;
+    telemetry_changed(_coalescer);
+}
+
+void SimScoreSink::update_high_score(uint32_t high_score)
+{
+    _telemetry.high_score = high_score;
+    telemetry_changed(_coalescer);
+}
+
+void SimScoreSink::update_instruction(int instruction, std::chrono::microseconds rate, uint32_t reaction_us)
+{
+    _telemetry.instruction = instruction;
+    _telemetry.rate_ms = std::chrono::duration_cast<std::chrono::milliseconds>(rate).count();
+    _telemetry.reaction_ms = std::min<uint32_t>(reaction_us / 1000, UINT16_MAX);
+    _reaction_us = reaction_us;
+    telemetry_changed(_coalescer);
+}
+
+void SimScoreSink::flush()
+{
+    // the simulated phone is always subscribed
+    if (!_coalescer.take(true))
+        return;
+
+    pack_telemetry(_telemetry, _packed);
+    sim_clock().advance_to(sim_clock().now() + _write_time);
+    _sent_at = sim_clock().now();
+    _writes++;
+    if (_telemetry.point) {
+        uint32_t written_us = _sent_at.count();
+        latency_record(LATENCY_VERDICT_TO_NOTIFY, written_us - _telemetry.verdict_us);
+        latency_record(LATENCY_LED_TO_NOTIFY, written_us - _telemetry.shown_us);
+        _telemetry.point = false;
+    }
+}
+
+bool SimScoreSink::next_connection_event(std::chrono::microseconds *t) const
+{
+    if (!_coalescer.in_flight()) return false;
+    *t = _sent_at + _interval;
+    return true;
+}
+
+void SimScoreSink::connection_event()
+{
+    if (_coalescer.sent())
+        flush();
+}
+
+void SimScoreSink::update_latency()
+{
+    pack_latency(_latency);
+    _writes++;
+}
+
+int SimNfcTag::start(void (*on_session)(bool open, uint32_t time_us))
+{
+    _on_session = on_session;
+    _message.clear();
+    return 0;
+}
+
+void SimNfcTag::read(void (*on_message)(const uint8_t *data, size_t size))
+{
+    _reads++;
+    sim_clock().advance_to(sim_clock().now() + _read_time);
+    on_message(_message.data(), _message.size());
+}
+
+void SimNfcTag::tap(const std::string &text, std::chrono::microseconds at, std::chrono::microseconds session)
+{
+    _text = text;
+    _open_at = at;
+    _close_at = at + session;
+}
+
+bool SimNfcTag::next_edge(std::chrono::microseconds *t) const
+{
+    if (_on_session == nullptr || _close_at.count() < 0) return false;
+    *t = _open_at.count() >= 0 ? _open_at : _close_at;
+    return true;
+}
+
+void SimNfcTag::update()
+{
+    std::chrono::microseconds now = sim_clock().now();
+    if (_on_session != nullptr && _open_at.count() >= 0 && _open_at <= now) {
+        _on_session(true, _open_at.count());
+        _open_at = std::chrono::microseconds(-1);
+    }
+    if (_on_session != nullptr && _close_at.count() >= 0 && _close_at <= now) {
+        // short record: MB, ME, SR, TNF well-known; type "T"; status (UTF-8, 5-byte language)
+        _message = {0xd1, 0x01, (uint8_t)(6 + _text.size()), 'T', 0x05, 'e', 'n', '-', 'U', 'S'};
+        _message.insert(_message.end(), _text.begin(), _text.end());
+        _on_session(false, _close_at.count());
+        _close_at = std::chrono::microseconds(-1);
+    }
+}
+
+// TDBStore record header, and the master record starting each area
+#define store_header_size 24
+#define store_master_size 32
+
+size_t SimRecordStore::record_size(const std::string &key, size_t size) const
+{
+    size_t bytes = store_header_size + key.size() + size;
+    return (bytes + _program_unit - 1) / _program_unit * _program_unit;
+}
+
+void SimRecordStore::set_geometry(size_t area_size, size_t program_unit)
+{
+    _area_size = area_size;
+    _program_unit = program_unit;
+}
+
+int SimRecordStore::open(const char *path)
+{
+    _path = path;
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+        return 0;
+
+    // each record: key size (2), key, data size (4), data, little-endian
+    uint8_t size_buf[4];
+    while (fread(size_buf, 1, 2, file) == 2) {
+        std::string key(size_buf[0] | size_buf[1] << 8, '\0');
+        if (fread(&key[0], 1, key.size(), file) != key.size() || fread(size_buf, 1, 4, file) != 4)
+            break;
+        std::vector<uint8_t> data(size_buf[0] | size_buf[1] << 8 | size_buf[2] << 16 | (uint32_t)size_buf[3] << 24);
+        if (fread(data.data(), 1, data.size(), file) != data.size())
+            break;
+        _records[key] = data;
+        _used += record_size(key, data.size());
+    }
+    bool ok = feof(file);
+    fclose(file);
+    return ok ? 0 : -1;
+}
+
+int SimRecordStore::save() const
+{
+    if (_path.empty())
+        return 0;
+
+    FILE *file = fopen(_path.c_str(), "wb");
+    if (file == nullptr)
+        return -1;
+
+    for (const auto &record : _records) {
+        uint32_t key_size = record.first.size(), size = record.second.size();
+        uint8_t sizes[6] = {(uint8_t)key_size, (uint8_t)(key_size >> 8),
+                            (uint8_t)size, (uint8_t)(size >> 8), (uint8_t)(size >> 16), (uint8_t)(size >> 24)};
+        fwrite(sizes, 1, 2, file);
+        fwrite(record.first.data(), 1, key_size, file);
+        fwrite(sizes + 2, 1, 4, file);
+        fwrite(record.second.data(), 1, size, file);
+    }
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+int SimRecordStore::get(const char *key, void *buf, size_t size, size_t *actual)
+{
+    auto it = _records.find(key);
+    if (it == _records.end())
+        return -1;
+
+    memcpy(buf, it->second.data(), std::min(size, it->second.size()));
+    if (actual != nullptr)
+        *actual = it->second.size();
+    return 0;
+}
+
+int SimRecordStore::set(const char *key, const void *buf, size_t size)
+{
+    _stats.sets++;
+    _stats.bytes_set += size;
+
+    size_t needed = record_size(key, size);
+    if (store_master_size + _used + needed > _area_size) {
+        // garbage collection: erase the other area, copy the live records over
+        _stats.bytes_erased += _area_size;
+        _used = 0;
+        for (const auto &record : _records)
+            if (record.first != key)
+                _used += record_size(record.first, record.second.size());
+        _stats.bytes_programmed += store_master_size + _used;
+        if (store_master_size + _used + needed > _area_size)
+            return -1;
+    }
+
+    _used += needed;
+    _stats.bytes_programmed += needed;
+    const uint8_t *data = static_cast<const uint8_t *>(buf);
+    _records[key].assign(data, data + size);
+    return save();
+}
+
+SimClock& sim_clock()
+{
+    static SimClock clock;
+    return clock;
+}
+
+SimDistanceSensor& sim_distance_sensor()
+{
+    static SimDistanceSensor sensor;
+    return sensor;
+}
+
+SimLeds& sim_leds()
+{
+    static SimLeds leds;
+    return leds;
+}
+
+SimButton& sim_button()
+{
+    static SimButton button;
+    return button;
+}
+
+SimEventLoop& sim_event_loop()
+{
+    static SimEventLoop event_loop;
+    return event_loop;
+}
+
+SimNfcTag& sim_nfc_tag()
+{
+    static SimNfcTag tag;
+    return tag;
+}
+
+SimRecordStore& sim_record_store()
+{
+    static SimRecordStore store;
+    return store;
+}
+
+// 115200 baud, 10 bits a byte
+#define uart_bytes_per_s 11520
+
+void SimConsoleSink::kick(ConsoleRing &ring)
+{
+    _ring = &ring;
+    if (!_sending) {
+        _sending = true;
+        _sent_until = sim_clock().now();
+    }
+}
+
+void SimConsoleSink::update()
+{
+    if (!_sending)
+        return;
+
+    std::chrono::microseconds now = sim_clock().now();
+    long long bytes = (now - _sent_until).count() * uart_bytes_per_s / 1000000;
+    long long sent = 0;
+    char c;
+    while (sent < bytes && _ring->pop(&c)) {
+        fputc(c, stdout);
+        sent++;
+    }
+    _sent_until += std::chrono::microseconds(sent * 1000000 / uart_bytes_per_s);
+    if (_ring->size() == 0)
+        _sending = false;
+}
+
+void SimConsoleSink::flush()
+{
+    char c;
+    while (_ring != nullptr && _ring->pop(&c))
+        fputc(c, stdout);
+    _sending = false;
+}
+
+SimConsoleSink& sim_console_sink()
+{
+    static SimConsoleSink sink;
+    return sink;
+}
+
+SimScoreSink& sim_score_sink()
+{
+    static SimScoreSink sink;
+    return sink;
+}
+
+DistanceSensor& get_distance_sensor() { return sim_distance_sensor(); }
+Leds& get_leds() { return sim_leds(); }
+Button& get_button() { return sim_button(); }
+Clock& get_clock() { return sim_clock(); }
+RecordStore& get_record_store() { return sim_record_store(); }
+NfcTag& get_nfc_tag() { return sim_nfc_tag(); }
+EventLoop& get_event_loop() { return sim_event_loop(); }
+ScoreSink& get_score_sink() { return sim_score_sink(); }
+ConsoleSink& get_console_sink() { return sim_console_sink(); }
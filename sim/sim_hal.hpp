@@ -0,0 +1,432 @@
+/**
+ * @file sim_hal.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief simulated devices for running the game on a Linux host.
+ *        Time is virtual: it only moves when the simulation advances
+ *        the clock, or when a device models a blocking operation.
+ */
+#ifndef SIM_HAL_HPP
+#define SIM_HAL_HPP
+
+#include "hal.hpp"
+#include "i2c_timing.hpp"
+#include "latency.hpp"
+#include "telemetry.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// freeing the bus and init_sensor() after a stall, the VL53L0X boot and static init
+#define sim_sensor_restart std::chrono::microseconds(40000)
+
+/**
+ * @brief Virtual clock with a single one-shot timeout, like mbed::Timeout.
+ */
+class SimClock : public Clock
+{
+public:
+    std::chrono::microseconds now() override { return _now; }
+
+    void attach(void (*handler)(), std::chrono::microseconds delay) override;
+
+    void detach() override { _handler = nullptr; }
+
+    /**
+     * @brief Move virtual time forward to t, firing the timeout
+     *        on the way as the ISR would.
+     */
+    void advance_to(std::chrono::microseconds t);
+
+    /**
+     * @brief When the pending timeout fires.
+     *
+     * @return false if there is none.
+     */
+    bool deadline(std::chrono::microseconds *t) const;
+
+    /**
+     * @brief Number of timeouts attached so far.
+     */
+    uint32_t attach_count() const { return _attach_count; }
+
+private:
+    std::chrono::microseconds _now{0};
+    std::chrono::microseconds _deadline{0};
+    void (*_handler)() = nullptr;
+    uint32_t _attach_count = 0;
+};
+
+/**
+ * @brief Simulated VL53L0X in continuous ranging mode.
+ *
+ * The distance comes from a model of the player's hand. While started,
+ * a new sample is ready every timing budget, and collecting it costs the
+ * event loop the I2C transfer time.
+ */
+class SimDistanceSensor : public DistanceSensor
+{
+public:
+    int start_continuous(void (*on_sample)(uint32_t ready_us)) override;
+
+    void stop() override { _running = false; }
+
+    int set_profile(ranging_profile_t profile) override;
+
+    ranging_profile_t profile() const override { return _profile; }
+
+    SampleRing &samples() override { return _samples; }
+
+    SensorStats stats() override { return _stats; }
+
+    /**
+     * @brief When the next sample will be ready.
+     *
+     * @return false if the sensor is stopped.
+     */
+    bool next_sample(std::chrono::microseconds *t) const;
+
+    /**
+     * @brief Collect the samples that became ready and call on_sample,
+     *        as the event loop would after the data-ready interrupts.
+     */
+    void collect();
+
+    /**
+     * @brief Set the hand model, giving the true distance (mm) at a time.
+     */
+    void set_hand(std::function<uint32_t(std::chrono::microseconds)> hand) { _hand = hand; }
+
+    /**
+     * @brief Seed and standard deviation (mm) of the measurement noise,
+     *        at the default profile. It goes with the square root of
+     *        the timing budget, as the photons counted do.
+     */
+    void set_noise(uint32_t seed, double sigma_mm);
+
+    /**
+     * @brief Make a share of the samples (0 to 1) read mm instead of the
+     *        hand, like the VL53L0X does on a stray reflection.
+     */
+    void set_outliers(double probability, uint32_t mm);
+
+    /**
+     * @brief Time between two samples.
+     */
+    void set_timing_budget(std::chrono::microseconds budget) { _budget = budget; }
+
+    /**
+     * @brief Time spent collecting one sample, its burst read at
+     *        sensor_i2c_hz by default.
+     */
+    void set_transfer_time(std::chrono::microseconds transfer) { _transfer = transfer; }
+
+    /**
+     * @brief Make a share of the transfers (0 to 1) fail, and of the
+     *        samples wedge the sensor until the stall watchdog resets it,
+     *        as MbedDistanceSensor does on the board.
+     */
+    void set_faults(double glitch_probability, double wedge_probability);
+
+private:
+    /**
+     * @brief Set the noise of the current profile.
+     */
+    void scale_noise();
+
+    std::function<uint32_t(std::chrono::microseconds)> _hand;
+    std::mt19937 _rng{0};
+    std::normal_distribution<double> _noise{0.0, 0.0};
+    double _sigma_mm = 0;
+    ranging_profile_t _profile = RANGING_DEFAULT;
+    std::bernoulli_distribution _outlier{0.0};
+    uint32_t _outlier_mm = 0;
+    // the VL53L0X default timing budget is about 33 ms
+    std::chrono::microseconds _budget{33000};
+    // reading the result and clearing the interrupt
+    std::chrono::microseconds _transfer{i2c_time_us(burst_sample_transactions, sensor_i2c_hz)};
+    std::bernoulli_distribution _glitch{0.0};
+    std::bernoulli_distribution _wedge{0.0};
+    bool _running = false;
+    void (*_on_sample)(uint32_t ready_us) = nullptr;
+    std::chrono::microseconds _next_sample{0};
+    SampleRing _samples;
+    SensorStats _stats = {};
+};
+
+/**
+ * @brief Simulated LEDs. The level of a blinking LED is worked out
+ *        from the virtual time, so blinking costs nothing.
+ */
+class SimLeds : public Leds
+{
+public:
+    void show(led_mode_t led1, led_mode_t led2, std::chrono::milliseconds half_period) override;
+
+    /**
+     * @brief Level of LED1 (led == 1) or LED2 (led == 2) right now.
+     */
+    int read(int led) const;
+
+    /**
+     * @brief Number of patterns shown so far.
+     */
+    uint32_t patterns() const { return _patterns; }
+
+private:
+    led_mode_t _modes[2] = {LED_OFF, LED_OFF};
+    std::chrono::milliseconds _half_period{100};
+    std::chrono::microseconds _since{0};
+    uint32_t _patterns = 0;
+};
+
+/**
+ * @brief Simulated user button.
+ */
+class SimButton : public Button
+{
+public:
+    void rise(void (*handler)()) override { _handler = handler; }
+
+    /**
+     * @brief Press and release the button.
+     *        Runs the handler directly, as the event queue would.
+     */
+    void press();
+
+private:
+    void (*_handler)() = nullptr;
+};
+
+/**
+ * @brief Simulated event loop: a FIFO the simulation drains.
+ */
+class SimEventLoop : public EventLoop
+{
+public:
+    void post(void (*handler)(int, uint32_t), int event, uint32_t time_us) override;
+
+    /**
+     * @brief Run everything posted so far, including what gets posted meanwhile.
+     *
+     * @return number of handlers run.
+     */
+    uint32_t run();
+
+private:
+    struct Posted {
+        void (*handler)(int, uint32_t);
+        int event;
+        uint32_t time_us;
+    };
+
+    std::deque<Posted> _posted;
+};
+
+/**
+ * @brief Records the scores that would be sent over BLE.
+ */
+class SimScoreSink : public ScoreSink
+{
+public:
+    void update_score(uint32_t score) override;
+
+    void update_point(uint32_t score, uint32_t verdict_us, uint32_t shown_us) override;
+
+    void update_high_score(uint32_t high_score) override;
+
+    void update_instruction(int instruction, std::chrono::microseconds rate, uint32_t reaction_us) override;
+
+    void update_latency() override;
+
+    /**
+     * @brief Write the telemetry, as GameService::flush().
+     */
+    void flush();
+
+    /**
+     * @brief When the notification in flight will have been sent,
+     *        one connection interval after it was written.
+     *
+     * @return false if none is in flight.
+     */
+    bool next_connection_event(std::chrono::microseconds *t) const;
+
+    /**
+     * @brief The connection event happened, as GameService::onDataSent().
+     */
+    void connection_event();
+
+    uint32_t score() const { return _telemetry.score; }
+
+    uint32_t high_score() const { return _telemetry.high_score; }
+
+    /**
+     * @brief The reaction sent with the last instruction, in us.
+     */
+    uint32_t reaction_us() const { return _reaction_us; }
+
+    /**
+     * @brief GATT writes of any characteristic.
+     */
+    uint32_t writes() const { return _writes; }
+
+    const NotifyCoalescer &coalescer() const { return _coalescer; }
+
+    /**
+     * @brief Time a GATT write of the telemetry holds the writing thread.
+     */
+    void set_write_time(std::chrono::microseconds write_time) { _write_time = write_time; }
+
+private:
+    telemetry_t _telemetry = {0, 0, 0xff, 0, 0, false, 0, 0};
+    uint8_t _packed[telemetry_size] = {};
+    NotifyCoalescer _coalescer;
+    std::chrono::microseconds _interval{30000};
+    std::chrono::microseconds _sent_at{0};
+    // the ACI command carrying the value to the BlueNRG-MS, over SPI
+    std::chrono::microseconds _write_time{250};
+    uint32_t _writes = 0;
+    uint32_t _reaction_us = 0;
+    uint8_t _latency[latency_summary_size] = {};
+};
+
+/**
+ * @brief Simulated M24SR tag, written to by a simulated phone.
+ */
+class SimNfcTag : public NfcTag
+{
+public:
+    int start(void (*on_session)(bool open, uint32_t time_us)) override;
+
+    /**
+     * @brief Read the message, costing the event loop the I2C read time.
+     */
+    void read(void (*on_message)(const uint8_t *data, size_t size)) override;
+
+    void stop() override { _on_session = nullptr; }
+
+    /**
+     * @brief A phone opens an RF session at time at, writes text as an
+     *        NDEF Text record ("en"), and closes the session after session.
+     */
+    void tap(const std::string &text, std::chrono::microseconds at, std::chrono::microseconds session);
+
+    /**
+     * @brief When the phone next opens or closes a session.
+     *
+     * @return false if it won't.
+     */
+    bool next_edge(std::chrono::microseconds *t) const;
+
+    /**
+     * @brief Open / close the sessions that are due, as the GPO interrupt would.
+     */
+    void update();
+
+    uint32_t reads() const { return _reads; }
+
+    void set_read_time(std::chrono::microseconds read_time) { _read_time = read_time; }
+
+private:
+    void (*_on_session)(bool open, uint32_t time_us) = nullptr;
+    std::vector<uint8_t> _message;
+    std::string _text;
+    std::chrono::microseconds _open_at{-1};
+    std::chrono::microseconds _close_at{-1};
+    // selecting the NDEF file and reading it over I2C
+    std::chrono::microseconds _read_time{15000};
+    uint32_t _reads = 0;
+};
+
+/**
+ * @brief Simulated TDBStore: a log of records in one of two flash areas.
+ *
+ * Every set() appends a header, the key and the data, rounded up to the
+ * program unit. When the active area is full, the live records are
+ * copied to the other area after erasing it. Only the costs are
+ * simulated, the records themselves are kept in a map, and optionally
+ * in a file so that they survive the process.
+ */
+class SimRecordStore : public RecordStore
+{
+public:
+    /**
+     * @brief Keep the records in path, loading what it holds.
+     *
+     * @return 0 on success, negative if the file exists but cannot be read.
+     */
+    int open(const char *path);
+
+    int get(const char *key, void *buf, size_t size, size_t *actual) override;
+
+    int set(const char *key, const void *buf, size_t size) override;
+
+    StoreStats stats() override { return _stats; }
+
+    /**
+     * @brief Area size and program unit, in bytes.
+     */
+    void set_geometry(size_t area_size, size_t program_unit);
+
+private:
+    size_t record_size(const std::string &key, size_t size) const;
+
+    int save() const;
+
+    std::map<std::string, std::vector<uint8_t>> _records;
+    std::string _path;
+    size_t _area_size = 32 * 1024;
+    size_t _program_unit = 8;
+    // bytes used in the active area, after its master record
+    size_t _used = 0;
+    StoreStats _stats = {0, 0, 0, 0};
+};
+
+/**
+ * @brief The UART at 115200 baud (10 bits a byte): the text goes to
+ *        stdout as fast as the UART would have sent it in virtual time.
+ */
+class SimConsoleSink : public ConsoleSink
+{
+public:
+    void kick(ConsoleRing &ring) override;
+
+    /**
+     * @brief Send what the UART had time for since the last call.
+     */
+    void update();
+
+    /**
+     * @brief Send the rest, at the end of the run.
+     */
+    void flush();
+
+private:
+    ConsoleRing *_ring = nullptr;
+    bool _sending = false;
+    // when the UART finished the last byte it sent
+    std::chrono::microseconds _sent_until{0};
+};
+
+/**
+ * Accessors for the simulated devices behind the hal.hpp factories.
+ */
+SimClock& sim_clock();
+SimDistanceSensor& sim_distance_sensor();
+SimLeds& sim_leds();
+SimButton& sim_button();
+SimEventLoop& sim_event_loop();
+SimScoreSink& sim_score_sink();
+SimRecordStore& sim_record_store();
+SimNfcTag& sim_nfc_tag();
+SimConsoleSink& sim_console_sink();
+
+#endif
@@ -0,0 +1,249 @@
+/**
+ * @file sim_main.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief plays a full session (calibration, tutorial, game) on the host
+ *        against simulated devices, then reports how often the game
+ *        woke up and how long it blocked the event queue.
+ *
+ * usage: sim_flappy [--early] [--adaptive] [--store file] [--trace file] [seed] [instructions] [reaction_ms]
+ *        the simulated player gets the first `instructions` right
+ *        and then makes a mistake, which ends the game.
+ *        --early turns on early_accept.
+ *        --adaptive picks the deadlines with AdaptiveDifficulty.
+ *        --store keeps the player records in file, across runs.
+ *        --trace writes the game's trace to file, for replay_trace.
+ */
+#include "boot_times.hpp"
+#include "console_out.hpp"
+#include "game.hpp"
+#include "latency.hpp"
+#include "name_capture.hpp"
+#include "sim_hal.hpp"
+#include "sim_player.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std::chrono;
+using namespace std::chrono_literals;
+
+static void name_read(const char *name)
+{
+    game_switch_player(name);
+}
+
+/**
+ * @brief Min / mean / max accumulator.
+ */
+struct Stats {
+    uint64_t count = 0;
+    double sum = 0;
+    double max = 0;
+
+    void add(double value)
+    {
+        count++;
+        sum += value;
+        max = std::max(max, value);
+    }
+
+    double mean() const { return count ? sum / count : 0; }
+};
+
+int main(int argc, char **argv)
+{
+    uint32_t args[3] = {1, 20, 250};
+    int count = 0;
+    const char *trace_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--early") == 0)
+            early_accept = true;
+        else if (strcmp(argv[i], "--adaptive") == 0)
+            difficulty = &adaptive_difficulty;
+        else if (strcmp(argv[i], "--store") == 0 && i + 1 < argc) {
+            if (sim_record_store().open(argv[++i]) != 0) {
+                fprintf(stderr, "cannot read %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            trace_path = argv[++i];
+        else if (count < 3)
+            args[count++] = strtoul(argv[i], nullptr, 10);
+    }
+    uint32_t seed = args[0];
+    uint32_t correct = args[1];
+    milliseconds reaction{args[2]};
+
+    instruction_seed = seed;
+    Player player(100, 320, reaction);
+    SimClock &clock = sim_clock();
+    SimDistanceSensor &sensor = sim_distance_sensor();
+    SimScoreSink &sink = sim_score_sink();
+    sensor.set_hand([&player](microseconds t) { return player.distance_at(t); });
+    sensor.set_noise(seed, 3.0);
+
+    // boot: the game starts as the remembered player right away, the
+    // player taps their phone at 2 s and the RF session lasts 400 ms
+    const microseconds tap_at = 2s, tap_session = 400ms;
+    SimNfcTag &tag = sim_nfc_tag();
+    tag.tap("sim", tap_at, tap_session);
+    name_capture_start(name_read);
+    game_init();
+    game_load_remembered_player();
+    game_post(EVENT_CONNECTED);
+
+    // nothing polls: the simulation jumps from one event to the next
+    const microseconds limit = 3600s;
+    const microseconds press_gap = 500ms;
+    microseconds last_press = -1s;
+    uint32_t attach_seen = 0;
+    uint32_t shown = 0;
+    int shown_instruction = -1;
+    microseconds game_start{0};
+    Stats wall_ns, stall_us, reaction_ms;
+
+    while (clock.now() < limit && game_state != GAME_ENDED_PENDING) {
+        // run what the interrupts posted
+        microseconds started = clock.now();
+        steady_clock::time_point wall_start = steady_clock::now();
+        uint32_t handled = sim_event_loop().run();
+        if (handled) {
+            wall_ns.add(duration_cast<nanoseconds>(steady_clock::now() - wall_start).count());
+            stall_us.add((clock.now() - started).count());
+        }
+
+        // a new instruction attaches a new read timeout
+        if (clock.attach_count() != attach_seen) {
+            attach_seen = clock.attach_count();
+            if (game_state == GAME_STARTED) {
+                if (shown == 0)
+                    game_start = clock.now();
+                else if (shown_instruction != 12)
+                    reaction_ms.add(sink.reaction_us() / 1000.0);
+                player.respond(instruction, clock.now(), shown == correct);
+                shown_instruction = instruction;
+                shown++;
+            }
+        }
+
+        if (game_state == GAME_ENDED_PENDING)
+            break;
+
+        // press through calibration and the tutorial
+        bool waiting = game_state == GAME_INITIALIZED ||
+                       game_state == GAME_CALIBRATION_NEAR_PENDING ||
+                       game_state == GAME_CALIBRATION_FAR_PENDING ||
+                       game_state == GAME_TUTORIAL;
+
+        // next thing to happen: a press, the timeout, a sample, a connection event or the tap
+        microseconds next = limit, t;
+        if (waiting)
+            next = std::max(clock.now(), last_press + press_gap);
+        if (clock.deadline(&t))
+            next = std::min(next, t);
+        if (sensor.next_sample(&t))
+            next = std::min(next, t);
+        if (sink.next_connection_event(&t))
+            next = std::min(next, t);
+        if (tag.next_edge(&t))
+            next = std::min(next, t);
+        if (next == limit)
+            break;
+
+        clock.advance_to(std::max(next, clock.now()));
+        if (waiting && clock.now() - last_press >= press_gap) {
+            if (game_state == GAME_INITIALIZED)
+                player.hold(player.near_mm(), clock.now(), clock.now());
+            else if (game_state == GAME_CALIBRATION_NEAR_PENDING)
+                player.hold(player.far_mm(), clock.now(), clock.now());
+            sim_button().press();
+            last_press = clock.now();
+        }
+        sensor.collect();
+        if (sink.next_connection_event(&t) && t <= clock.now())
+            sink.connection_event();
+        tag.update();
+        sim_console_sink().update();
+    }
+    sim_event_loop().run();
+    sim_console_sink().flush();
+
+    uint32_t trace_samples = 0;
+    TraceReader reader(game_trace.data(), game_trace.size());
+    trace_record_t record;
+    while (reader.next(&record))
+        trace_samples += record.type == TRACE_SAMPLE;
+    if (trace_path != nullptr) {
+        FILE *file = fopen(trace_path, "wb");
+        bool written = file != nullptr && fwrite(game_trace.data(), 1, game_trace.size(), file) == game_trace.size();
+        if (file != nullptr)
+            fclose(file);
+        if (!written) {
+            fprintf(stderr, "cannot write %s\n", trace_path);
+            return 1;
+        }
+    }
+
+    printf("\n\n ===== Simulation Report =====\n\n");
+    printf("seed: %u, reaction: %lld ms, early accept: %s, difficulty: %s\n",
+           seed, (long long)reaction.count(), early_accept ? "on" : "off", difficulty->name());
+    printf("virtual time: %.3f s\n", clock.now().count() / 1e6);
+    // reading the tag every 1.5 s instead: the first read after the session closed finds the name
+    const microseconds poll = 1500ms, closed = tap_at + tap_session;
+    long long poll_reads = (closed + poll - 1us) / poll;
+    microseconds read_time = microseconds(name_capture_stats.latency_us) - tap_session;
+    microseconds polled = poll_reads * poll + read_time - tap_at;
+    printf("NFC name \"%s\": recognized %.0f ms after the tap with %u tag reads "
+           "(polling every 1.5 s: %.0f ms, %lld reads)\n",
+           player_name, name_capture_stats.latency_us / 1e3, tag.reads(),
+           polled.count() / 1e3, poll_reads);
+    uint32_t playable_us = 0, name_us = 0;
+    if (boot_time(BOOT_PLAYABLE, &playable_us) && boot_time(BOOT_NAME_READ, &name_us))
+        printf("boot to playable: %.0f ms (%.0f ms waiting for the NFC name first)\n",
+               playable_us / 1e3, (name_us + playable_us) / 1e3);
+    printf("instructions shown: %u, score: %u, high score: %u\n",
+           shown, sink.score(), sink.high_score());
+    double game_minutes = (clock.now() - game_start).count() / 60e6;
+    printf("instructions per minute: %.1f, measured reaction: mean %.0f ms, max %.0f ms\n",
+           shown / game_minutes, reaction_ms.mean(), reaction_ms.max);
+    uint64_t wakeups = 0;
+    for (const dispatch_stats_t &stats : dispatch_stats)
+        wakeups += stats.dispatches;
+    printf("game wakeups: %llu (%.1f/s)\n", (unsigned long long)wakeups, wakeups / (clock.now().count() / 1e6));
+    printf("posted event wall time: mean %.0f ns, max %.0f ns\n", wall_ns.mean(), wall_ns.max);
+    printf("queue stall per posted event: mean %.0f us, max %.0f us\n", stall_us.mean(), stall_us.max);
+    SensorStats sensor_stats = sensor.stats();
+    printf("sensor samples: %u (%.1f samples/s), errors: %u, queue busy %lld ms\n",
+           sensor_stats.samples, sensor_stats.samples / (clock.now().count() / 1e6),
+           sensor_stats.errors, (long long)duration_cast<milliseconds>(sensor_stats.busy).count());
+    printf("sample ring: high water %u/%u, overflows %u, read periods that lost samples %u\n",
+           sensor.samples().high_water(), sensor.samples().capacity(),
+           sensor.samples().overflows(), lost_sample_windows);
+    printf("LED patterns shown: %u\n", sim_leds().patterns());
+    StoreStats store_stats = sim_record_store().stats();
+    printf("player store: %u writes, %llu bytes written, %llu programmed, %llu erased (amplification %.1fx)\n",
+           store_stats.sets, (unsigned long long)store_stats.bytes_set,
+           (unsigned long long)store_stats.bytes_programmed, (unsigned long long)store_stats.bytes_erased,
+           store_stats.bytes_set ? (double)(store_stats.bytes_programmed + store_stats.bytes_erased) / store_stats.bytes_set : 0.0);
+    printf("telemetry: %u changes, %u notifications (%.2f per instruction), %u GATT writes\n",
+           sink.coalescer().changes(), sink.coalescer().sends(),
+           shown ? (double)sink.coalescer().sends() / shown : 0.0, sink.writes());
+    printf("game trace: %u bytes (%.1f per sample given to the classifier), %u instructions dropped\n",
+           (unsigned)game_trace.size(), trace_samples ? (double)game_trace.size() / trace_samples : 0.0,
+           (unsigned)game_trace.dropped());
+    printf("\n");
+    print_console_stats();
+    print_boot_times();
+    print_dispatch_stats();
+    print_ranging_stats();
+    printf("\n");
+    print_latency();
+
+    return game_state == GAME_ENDED_PENDING ? 0 : 1;
+}
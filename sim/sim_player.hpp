@@ -0,0 +1,91 @@
+/**
+ * @file sim_player.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief the simulated player, shared by sim_flappy and sim_batch
+ */
+#ifndef SIM_PLAYER_HPP
+#define SIM_PLAYER_HPP
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief A player following the instructions, modelled as the
+ *        distance (mm) between their hand and the sensor over time.
+ */
+class Player
+{
+public:
+    Player(uint32_t near_mm, uint32_t far_mm, std::chrono::microseconds reaction) :
+        _near(near_mm), _far(far_mm), _reaction(reaction)
+    { }
+
+    uint32_t distance_at(std::chrono::microseconds t) const
+    {
+        if (_alternating && t >= _move_at)
+            return ((t - _move_at) / _half_period) % 2 ? _near : _far;
+        return t >= _move_at ? _to : _from;
+    }
+
+    /**
+     * @brief Move the hand to mm at time at, and keep it there.
+     */
+    void hold(uint32_t mm, std::chrono::microseconds now, std::chrono::microseconds at)
+    {
+        _from = distance_at(now);
+        _to = mm;
+        _move_at = at;
+        _alternating = false;
+    }
+
+    /**
+     * @brief React to a new instruction shown at time now.
+     */
+    void respond(int instr, std::chrono::microseconds now, bool mistake)
+    {
+        std::chrono::microseconds at = now + _reaction;
+        bool near = instr == 1 || instr == 10;
+        bool far = instr == 0 || instr == 11;
+
+        if (near || far) {
+            if (mistake) near = !near;
+            hold(near ? _near : _far, now, at);
+        }
+        else if ((instr == 2) != mistake) {
+            _from = distance_at(now);
+            _move_at = at;
+            _alternating = true;
+        }
+        else {
+            hold(distance_at(now), now, now);
+        }
+    }
+
+    /**
+     * @brief Reaction time to the next instructions.
+     */
+    void set_reaction(std::chrono::microseconds reaction) { _reaction = reaction; }
+
+    /**
+     * @brief Time the hand stays near (or far) while alternating.
+     */
+    void set_half_period(std::chrono::microseconds half_period) { _half_period = half_period; }
+
+    uint32_t near_mm() const { return _near; }
+
+    uint32_t far_mm() const { return _far; }
+
+private:
+    uint32_t _near;
+    uint32_t _far;
+    std::chrono::microseconds _reaction;
+    std::chrono::microseconds _half_period = std::chrono::milliseconds(150);
+    uint32_t _from = 0;
+    uint32_t _to = 0;
+    std::chrono::microseconds _move_at{0};
+    bool _alternating = false;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/**
+ * @file test_fsm.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief checks every event in every state against what the game did
+ *        before game_rules: the if/else chains of button1_rise_handler(),
+ *        main_game(), deadline_expired() and the disconnect path.
+ *
+ * usage: test_fsm
+ *        Prints the cells that differ, and returns 1 if any does.
+ */
+#include "game.hpp"
+#include "sim_hal.hpp"
+
+#include <cstdio>
+
+static const char *const state_names[] = {
+    "INITIALIZED", "CALIBRATION_NEAR", "CALIBRATION_NEAR_PENDING", "CALIBRATION_FAR",
+    "CALIBRATION_FAR_PENDING", "TUTORIAL", "STARTED", "PAUSED", "PAUSED_PENDING",
+    "ENDING", "ENDED", "ENDED_PENDING"
+};
+static_assert(sizeof(state_names) / sizeof(state_names[0]) == game_state_count, "a game state has no name");
+
+static const char *const event_names[] = {
+    "SAMPLE", "DEADLINE", "BUTTON", "CONNECTED", "DISCONNECTED", "CALIBRATED", "DONE"
+};
+static_assert(sizeof(event_names) / sizeof(event_names[0]) == game_event_count, "a game event has no name");
+
+/**
+ * @brief What one event in one state should do.
+ */
+typedef struct {
+    game_state_t next;
+    bool legal;
+} expected_t;
+
+/**
+ * @brief The state the old code moved to on event, written out from it
+ *        rather than from game_rules.
+ */
+static expected_t expected(game_state_t state, game_event_t event)
+{
+    switch (event) {
+    case EVENT_SAMPLE:
+    case EVENT_CONNECTED:
+        // samples were read by the states themselves, connecting only set a flag
+        return {state, true};
+    case EVENT_DISCONNECTED:
+        // from any state it ended the game; before one started, calibration
+        // and the tutorial now start over instead
+        return {state < GAME_STARTED ? GAME_INITIALIZED : GAME_ENDED, true};
+    case EVENT_BUTTON:
+        // button1_rise_handler(); the last tutorial press raises EVENT_DONE now
+        switch (state) {
+        case GAME_INITIALIZED: return {GAME_CALIBRATION_NEAR, true};
+        case GAME_CALIBRATION_NEAR_PENDING: return {GAME_CALIBRATION_FAR, true};
+        case GAME_CALIBRATION_FAR_PENDING: return {GAME_TUTORIAL, true};
+        case GAME_STARTED: return {GAME_PAUSED, true};
+        case GAME_PAUSED_PENDING: return {GAME_STARTED, true};
+        case GAME_ENDED_PENDING: return {GAME_STARTED, true};
+        default: return {state, true};
+        }
+    case EVENT_DEADLINE:
+        // deadline_expired() ended the read input period or the end blink,
+        // the calibration's timeouts only woke it up; elsewhere a deadline
+        // was ignored, it is now illegal as none is ever pending there
+        switch (state) {
+        case GAME_CALIBRATION_NEAR:
+        case GAME_CALIBRATION_FAR:
+        case GAME_STARTED:
+            return {state, true};
+        case GAME_ENDING: return {GAME_ENDED, true};
+        default: return {state, false};
+        }
+    case EVENT_CALIBRATED:
+        // a returning player's stored calibration skips the far distance
+        return state == GAME_CALIBRATION_NEAR ? expected_t{GAME_CALIBRATION_FAR_PENDING, true}
+                                              : expected_t{state, false};
+    case EVENT_DONE:
+        // the assignments at the end of each state's work in main_game()
+        switch (state) {
+        case GAME_CALIBRATION_NEAR: return {GAME_CALIBRATION_NEAR_PENDING, true};
+        case GAME_CALIBRATION_FAR: return {GAME_CALIBRATION_FAR_PENDING, true};
+        case GAME_TUTORIAL: return {GAME_STARTED, true};
+        case GAME_STARTED: return {GAME_ENDING, true};
+        case GAME_PAUSED: return {GAME_PAUSED_PENDING, true};
+        case GAME_ENDED: return {GAME_ENDED_PENDING, true};
+        default: return {state, false};
+        }
+    }
+    return {state, false};
+}
+
+int main()
+{
+    game_init();
+
+    uint32_t failures = 0, illegal = 0;
+    uint32_t illegal_before = illegal_transitions;
+    for (int s = 0; s < game_state_count; s++) {
+        for (int e = 0; e < game_event_count; e++) {
+            game_state = (game_state_t)s;
+            tutorial_state = TUTORIAL_START;
+            event_raised = false;
+
+            expected_t want = expected((game_state_t)s, (game_event_t)e);
+            uint32_t counted = illegal_transitions;
+            bool legal = game_transition((game_event_t)e);
+            illegal += !want.legal;
+            if (game_state != want.next || legal != want.legal || illegal_transitions - counted != !want.legal) {
+                printf("%s on %s: %s (%s), expected %s (%s)\n", state_names[s], event_names[e],
+                       state_names[game_state], legal ? "legal" : "illegal",
+                       state_names[want.next], want.legal ? "legal" : "illegal");
+                failures++;
+            }
+            // with the tutorial at its start, no transition finishes a state
+            if (event_raised) {
+                printf("%s on %s raised %s\n", state_names[s], event_names[e], event_names[raised_event]);
+                failures++;
+            }
+        }
+    }
+
+    // the press that ends the tutorial starts the game, through EVENT_DONE
+    game_state = GAME_TUTORIAL;
+    tutorial_state = TUTORIAL_GAME_END;
+    event_raised = false;
+    if (!game_transition(EVENT_BUTTON) || !event_raised || raised_event != EVENT_DONE ||
+        !game_transition(raised_event) || game_state != GAME_STARTED) {
+        printf("the last tutorial press did not start the game\n");
+        failures++;
+    }
+
+    // presses before a phone is connected are dropped before any transition
+    game_state = GAME_INITIALIZED;
+    game_dispatch(EVENT_DISCONNECTED, 0);
+    game_state = GAME_INITIALIZED;
+    game_dispatch(EVENT_BUTTON, 0);
+    if (game_state != GAME_INITIALIZED) {
+        printf("a press while disconnected moved to %s\n", state_names[game_state]);
+        failures++;
+    }
+
+    // a disconnect mid-calibration drops its samples, the next phone's press calibrates again
+    game_dispatch(EVENT_CONNECTED, 0);
+    game_dispatch(EVENT_BUTTON, 0);
+    bool collecting = game_state == GAME_CALIBRATION_NEAR && calibration_collecting;
+    game_dispatch(EVENT_DISCONNECTED, 0);
+    collecting = collecting && game_state == GAME_INITIALIZED && !calibration_collecting;
+    game_dispatch(EVENT_CONNECTED, 0);
+    game_dispatch(EVENT_BUTTON, 0);
+    if (!collecting || game_state != GAME_CALIBRATION_NEAR || !calibration_collecting) {
+        printf("a press after a disconnect mid-calibration moved to %s\n", state_names[game_state]);
+        failures++;
+    }
+    game_dispatch(EVENT_DISCONNECTED, 0);
+
+    if (illegal_transitions - illegal_before != illegal) {
+        printf("illegal transitions: %u, expected %u\n", (unsigned)(illegal_transitions - illegal_before),
+               (unsigned)illegal);
+        failures++;
+    }
+    sim_event_loop().run();
+
+    printf("%d states x %d events, %u illegal, %u failures\n", game_state_count, game_event_count,
+           (unsigned)illegal, (unsigned)failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file snapshot.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief lock-free single-writer snapshot of a small struct (a seqlock)
+ */
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * @brief A value one thread publishes and others read whole, never half
+ *        of an old one and half of a new one, without locks.
+ *
+ * The sequence is odd while publish() copies the value in; read() copies
+ * it out and tries again if the sequence was odd or moved in the meantime.
+ * The writer never waits. A reader only retries while a publish() is under
+ * way, so it must not preempt the writer: read() from threads, not ISRs.
+ *
+ * @tparam T    Value type, copied in and out.
+ */
+template <typename T>
+class Snapshot
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Snapshot values are copied byte by byte");
+
+public:
+    /**
+     * @brief Replace the value (writer only).
+     */
+    void publish(const T &value)
+    {
+        uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+        _sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        _value = value;
+        _sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    /**
+     * @brief The last published value, T{} before the first.
+     */
+    T read() const
+    {
+        for (;;) {
+            uint32_t before = _sequence.load(std::memory_order_acquire);
+            T value = _value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((before & 1) == 0 && _sequence.load(std::memory_order_relaxed) == before)
+                return value;
+        }
+    }
+
+private:
+    T _value{};
+    std::atomic<uint32_t> _sequence{0};
+};
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ * @file spsc_ring.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief lock-free single-producer / single-consumer ring buffer
+ */
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Fixed-capacity ring buffer that one producer (e.g. an ISR or a
+ *        thread) and one consumer can use at the same time without locks.
+ *
+ * push() and the producer-side counters may only be called by the producer,
+ * pop(), peek() and clear() only by the consumer. When the ring is full,
+ * push() drops the new item and counts it as an overflow.
+ *
+ * @tparam T    Item type, copied in and out.
+ * @tparam N    Capacity, must be a power of two.
+ */
+template <typename T, uint32_t N>
+class SpscRing
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    /**
+     * @brief Add an item (producer).
+     *
+     * @return false if the ring was full and the item was dropped.
+     */
+    bool push(const T &item)
+    {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        uint32_t used = head - _tail.load(std::memory_order_acquire);
+        if (used == N) {
+            _overflows.store(_overflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        _items[head & (N - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+
+        if (used + 1 > _high_water.load(std::memory_order_relaxed))
+            _high_water.store(used + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest item (consumer).
+     *
+     * @return false if the ring was empty.
+     */
+    bool pop(T *item)
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire))
+            return false;
+
+        *item = _items[tail & (N - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Look at the oldest item without taking it (consumer).
+     *
+     * @return false if the ring was empty.
+     */
+    bool peek(T *item) const
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire))
+            return false;
+
+        *item = _items[tail & (N - 1)];
+        return true;
+    }
+
+    /**
+     * @brief Drop everything currently in the ring (consumer).
+     */
+    void clear()
+    {
+        _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    uint32_t size() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr uint32_t capacity() { return N; }
+
+    /**
+     * @brief Number of items dropped because the ring was full.
+     */
+    uint32_t overflows() const { return _overflows.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Most items ever held at once.
+     */
+    uint32_t high_water() const { return _high_water.load(std::memory_order_relaxed); }
+
+private:
+    T _items[N];
+    // free-running indices, only the producer writes _head and only the consumer _tail
+    std::atomic<uint32_t> _head{0};
+    std::atomic<uint32_t> _tail{0};
+    std::atomic<uint32_t> _overflows{0};
+    std::atomic<uint32_t> _high_water{0};
+};
+
+#endif
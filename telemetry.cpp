@@ -0,0 +1,24 @@
+/**
+ * @file telemetry.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief packed game telemetry for BLE
+ */
+#include "telemetry.hpp"
+
+static uint8_t *put(uint8_t *buf, uint32_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        *buf++ = value >> (8 * i);
+    return buf;
+}
+
+void pack_telemetry(const telemetry_t &telemetry, uint8_t *buf)
+{
+    buf = put(buf, telemetry.score, 4);
+    buf = put(buf, telemetry.high_score, 4);
+    buf = put(buf, telemetry.instruction, 1);
+    buf = put(buf, telemetry.rate_ms, 2);
+    put(buf, telemetry.reaction_ms, 2);
+}
@@ -0,0 +1,116 @@
+/**
+ * @file telemetry.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief packed game telemetry for BLE, and notification coalescing
+ */
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include <cstdint>
+
+// packed size, fits in one notification at the default ATT MTU (20 bytes)
+#define telemetry_size 13
+
+/**
+ * @brief Everything the phone is told about the running game.
+ *
+ * Packed little-endian, in this order:
+ * score (4), high score (4), instruction (1), rate ms (2), reaction ms (2).
+ */
+typedef struct {
+    uint32_t score;
+    uint32_t high_score;
+    // see show_lights() for the encoding, 0xff before the first one
+    uint8_t instruction;
+    // time limit of the current instruction
+    uint16_t rate_ms;
+    // player's reaction to the previous instruction
+    uint16_t reaction_ms;
+    // not sent: whether the score just went up, and when its verdict was
+    // taken and its instruction's LEDs written, Clock::now() us, for the
+    // latency from them to the GATT write
+    bool point;
+    uint32_t verdict_us;
+    uint32_t shown_us;
+} telemetry_t;
+
+void pack_telemetry(const telemetry_t &telemetry, uint8_t *buf);
+
+/**
+ * @brief Turns any number of changes into at most one notification in
+ *        flight, so a burst of changes (a point, then the next
+ *        instruction) costs a single GATT write and connection event.
+ *
+ * The owner calls changed() for every change and schedules a flush when
+ * it returns true; the flush calls take() and sends if it returns true.
+ * Once the stack reports the notification sent, sent() says whether
+ * another flush is due.
+ */
+class NotifyCoalescer
+{
+public:
+    /**
+     * @brief The value changed.
+     *
+     * @return true if a flush must be scheduled.
+     */
+    bool changed()
+    {
+        bool schedule = !_dirty && !_in_flight;
+        _dirty = true;
+        _changes++;
+        return schedule;
+    }
+
+    /**
+     * @brief Claim the changes for sending.
+     *
+     * @param notify Whether sending notifies a subscribed client,
+     *               which blocks the next send until sent().
+     * @return false if there is nothing to send, or a notification
+     *         is still in flight.
+     */
+    bool take(bool notify)
+    {
+        if (!_dirty || _in_flight)
+            return false;
+        _dirty = false;
+        _in_flight = notify;
+        _sends++;
+        return true;
+    }
+
+    /**
+     * @brief The stack sent the notification in flight.
+     *
+     * @return true if a flush must be scheduled.
+     */
+    bool sent()
+    {
+        _in_flight = false;
+        return _dirty;
+    }
+
+    /**
+     * @brief The client went away, nothing is in flight anymore.
+     *
+     * @return true if a flush must be scheduled.
+     */
+    bool reset() { return sent(); }
+
+    bool in_flight() const { return _in_flight; }
+
+    uint32_t changes() const { return _changes; }
+
+    uint32_t sends() const { return _sends; }
+
+private:
+    bool _dirty = false;
+    bool _in_flight = false;
+    uint32_t _changes = 0;
+    uint32_t _sends = 0;
+};
+
+#endif
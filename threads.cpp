@@ -0,0 +1,79 @@
+/**
+ * @file threads.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief the board's threads and their event queues
+ */
+#include "threads.hpp"
+#include "not.hpp"
+
+// a sample a period at most, the 2 KB of stack cover the VL53L0X API
+#define sensor_queue_size (16 * EVENTS_EVENT_SIZE)
+#define sensor_stack_size 2048
+// the BLE stack's own processing and the GATT writes
+#define ble_queue_size (32 * EVENTS_EVENT_SIZE)
+#define ble_stack_size 4096
+// only sends the console text, see MbedConsoleSink
+#define console_queue_size (4 * EVENTS_EVENT_SIZE)
+#define console_stack_size 1024
+
+static EventQueue sensor_queue(sensor_queue_size);
+static Thread sensor_thread(osPriorityHigh, sensor_stack_size, nullptr, "sensor");
+static EventQueue ble_queue(ble_queue_size);
+static Thread ble_thread(osPriorityBelowNormal, ble_stack_size, nullptr, "ble");
+static EventQueue console_queue(console_queue_size);
+static Thread console_thread(osPriorityLow, console_stack_size, nullptr, "console");
+
+Worker sensor_worker("sensor", sensor_queue);
+// the game keeps the main queue and thread, see flappy_init()
+Worker game_worker("game", queue);
+Worker ble_worker("ble", ble_queue);
+Worker console_worker("console", console_queue);
+
+void Worker::start(Thread &thread)
+{
+    thread.start(callback(&_queue, &EventQueue::dispatch_forever));
+    _id = thread.get_id();
+}
+
+void Worker::run()
+{
+    _id = ThisThread::get_id();
+    _queue.dispatch_forever();
+}
+
+void Worker::print_stats(std::chrono::microseconds uptime)
+{
+    uint32_t size = _id ? osThreadGetStackSize(_id) : 0;
+    // with platform.stack-stats-enabled the space left is the high-water mark
+    uint32_t used = _id ? size - osThreadGetStackSpace(_id) : 0;
+    printf("%-8s %8u %10llu %7.2f %6u/%u\n", _name, (unsigned)_calls,
+           (unsigned long long)(_busy.count() / 1000),
+           uptime.count() ? 100.0 * _busy.count() / uptime.count() : 0.0,
+           (unsigned)used, (unsigned)size);
+}
+
+void threads_start()
+{
+    sensor_worker.start(sensor_thread);
+    ble_worker.start(ble_thread);
+    console_worker.start(console_thread);
+}
+
+void print_thread_stats()
+{
+    std::chrono::microseconds uptime = get_clock().now();
+    printf("thread      calls    busy ms   cpu %%  stack used/size\n");
+    sensor_worker.print_stats(uptime);
+    game_worker.print_stats(uptime);
+    ble_worker.print_stats(uptime);
+    console_worker.print_stats(uptime);
+
+    mbed_stats_cpu_t cpu;
+    mbed_stats_cpu_get(&cpu);
+    if (cpu.uptime != 0)
+        printf("idle %.2f%% (sleep %.2f%%, deep sleep %.2f%%)\n",
+               100.0 * cpu.idle_time / cpu.uptime, 100.0 * cpu.sleep_time / cpu.uptime,
+               100.0 * cpu.deep_sleep_time / cpu.uptime);
+}
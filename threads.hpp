@@ -0,0 +1,106 @@
+/**
+ * @file threads.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief the board's threads, each dispatching its own event queue,
+ *        by priority:
+ *        sensor (VL53L0X reads) > game (main thread) > ble (BLE stack, GATT)
+ *        > console (game text to the UART)
+ *
+ *        The threads only talk through event queue calls and bounded
+ *        lock-free rings (spsc_ring.hpp): the samples from sensor to game,
+ *        the telemetry and latency summary from game to ble, the game
+ *        text from game to console.
+ */
+#ifndef THREADS_HPP
+#define THREADS_HPP
+
+#include "mbed.h"
+#include "hal.hpp"
+
+/**
+ * @brief An event queue, the thread dispatching it, and the time spent
+ *        in the calls made through call().
+ */
+class Worker
+{
+public:
+    Worker(const char *name, EventQueue &queue) : _name(name), _queue(queue) { }
+
+    /**
+     * @brief Call f(args...) on the worker's thread.
+     *        Safe to call from any thread and from interrupt context.
+     *
+     * @return the event id, 0 if the queue is full.
+     */
+    template <typename F, typename... Args>
+    int call(F f, Args... args)
+    {
+        return _queue.call([this, f, args...]() {
+            std::chrono::microseconds start = get_clock().now();
+            f(args...);
+            _busy += get_clock().now() - start;
+            _calls++;
+        });
+    }
+
+    /**
+     * @brief Call f(args...) on the worker's thread after delay, counted
+     *        like call().
+     *
+     * @return the event id, 0 if the queue is full.
+     */
+    template <typename F, typename... Args>
+    int call_in(std::chrono::milliseconds delay, F f, Args... args)
+    {
+        return _queue.call_in(delay, [this, f, args...]() {
+            std::chrono::microseconds start = get_clock().now();
+            f(args...);
+            _busy += get_clock().now() - start;
+            _calls++;
+        });
+    }
+
+    EventQueue &queue() { return _queue; }
+
+    /**
+     * @brief Dispatch the queue forever on thread.
+     */
+    void start(Thread &thread);
+
+    /**
+     * @brief Dispatch the queue forever on the calling thread.
+     */
+    void run();
+
+    /**
+     * @brief Print the calls, the time spent in them and the stack
+     *        high-water mark.
+     */
+    void print_stats(std::chrono::microseconds uptime);
+
+private:
+    const char *_name;
+    EventQueue &_queue;
+    osThreadId_t _id = nullptr;
+    uint32_t _calls = 0;
+    std::chrono::microseconds _busy{0};
+};
+
+extern Worker sensor_worker;
+extern Worker game_worker;
+extern Worker ble_worker;
+extern Worker console_worker;
+
+/**
+ * @brief Start the sensor, ble and console threads.
+ */
+void threads_start();
+
+/**
+ * @brief Print the per-thread counters and how long the CPU slept.
+ */
+void print_thread_stats();
+
+#endif
@@ -0,0 +1,247 @@
+/**
+ * @file trace.cpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief compact binary trace of a game
+ */
+#include "trace.hpp"
+
+#include <cstring>
+
+#define trace_type_bits 3
+#define trace_type_mask 0x07
+// largest varint of a 32-bit field, and of a record header
+#define varint_field_max 5
+#define varint_header_max 6
+
+// verdict flags
+#define trace_verdict_correct 0x01
+#define trace_verdict_early 0x02
+
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+void TraceWriter::start(uint32_t time_us, uint32_t seed, uint32_t near_dist, uint32_t far_dist,
+                        uint32_t still_range, bool early_accept)
+{
+    _size = 0;
+    _dropped = 0;
+    _active = true;
+    begin(TRACE_START, time_us, 7);
+    put(time_us);
+    put(trace_version);
+    put(seed);
+    put(near_dist);
+    put(far_dist);
+    put(still_range);
+    put(early_accept ? 1 : 0);
+    _header = _size;
+}
+
+void TraceWriter::sample(uint32_t time_us, uint32_t distance)
+{
+    if (!begin(TRACE_SAMPLE, time_us, 1))
+        return;
+    put(zigzag((int32_t)(distance - _last_distance)));
+    _last_distance = distance;
+}
+
+void TraceWriter::button(uint32_t time_us)
+{
+    begin(TRACE_BUTTON, time_us, 0);
+}
+
+void TraceWriter::instruction(uint32_t time_us, int instruction, uint32_t rate_us)
+{
+    if (!begin(TRACE_INSTRUCTION, time_us, 3))
+        return;
+    put(time_us);
+    put((uint32_t)instruction);
+    put(rate_us);
+    _last_distance = 0;
+}
+
+void TraceWriter::verdict(uint32_t time_us, const verdict_t &verdict, bool early, uint32_t reaction_us)
+{
+    if (!begin(TRACE_VERDICT, time_us, 3))
+        return;
+    put((verdict.correct ? trace_verdict_correct : 0) | (early ? trace_verdict_early : 0));
+    put(verdict.confidence);
+    put(reaction_us);
+}
+
+void TraceWriter::end(uint32_t time_us, uint32_t score)
+{
+    if (begin(TRACE_END, time_us, 2)) {
+        put(score);
+        put(_dropped);
+    }
+    _active = false;
+}
+
+int TraceWriter::save(RecordStore &store) const
+{
+    return store.set(trace_key, _buf, _size);
+}
+
+int TraceWriter::load(RecordStore &store)
+{
+    if (_active)
+        return -1;
+    size_t size = 0;
+    int err = store.get(trace_key, _buf, sizeof(_buf), &size);
+    if (err != 0 || size > sizeof(_buf)) {
+        _size = 0;
+        return err != 0 ? err : -1;
+    }
+    _size = size;
+    _header = 0;
+    _dropped = 0;
+    return 0;
+}
+
+bool TraceWriter::begin(trace_type_t type, uint32_t time_us, size_t fields)
+{
+    if (!_active)
+        return false;
+    size_t needed = varint_header_max + fields * varint_field_max;
+    while (_size + needed > sizeof(_buf))
+        if (!drop_instruction())
+            return false;
+
+    // start and instruction records carry their own time instead
+    uint64_t delta = 0;
+    if (type != TRACE_START && type != TRACE_INSTRUCTION)
+        delta = zigzag((int32_t)(time_us - _last_us));
+    _last_us = time_us;
+
+    uint64_t header = delta << trace_type_bits | type;
+    while (header >= 0x80) {
+        _buf[_size++] = (uint8_t)(header | 0x80);
+        header >>= 7;
+    }
+    _buf[_size++] = (uint8_t)header;
+    return true;
+}
+
+void TraceWriter::put(uint32_t value)
+{
+    while (value >= 0x80) {
+        _buf[_size++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    _buf[_size++] = (uint8_t)value;
+}
+
+bool TraceWriter::drop_instruction()
+{
+    // the records up to the second instruction after the start record go
+    TraceReader reader(_buf + _header, _size - _header);
+    trace_record_t record;
+    bool instruction = false;
+    size_t offset;
+    for (;;) {
+        offset = reader.offset();
+        if (!reader.next(&record))
+            return false;
+        if (record.type != TRACE_INSTRUCTION)
+            continue;
+        if (offset > 0)
+            break;
+        instruction = true;
+    }
+
+    memmove(_buf + _header, _buf + _header + offset, _size - _header - offset);
+    _size -= offset;
+    if (instruction)
+        _dropped++;
+    return true;
+}
+
+bool TraceReader::get(uint64_t *value)
+{
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && _offset < _size; shift += 7) {
+        uint8_t byte = _data[_offset++];
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    _malformed = true;
+    return false;
+}
+
+bool TraceReader::get(uint32_t *value)
+{
+    uint64_t wide;
+    if (!get(&wide) || wide > UINT32_MAX) {
+        _malformed = true;
+        return false;
+    }
+    *value = (uint32_t)wide;
+    return true;
+}
+
+bool TraceReader::next(trace_record_t *record)
+{
+    if (_malformed || _offset == _size)
+        return false;
+
+    uint64_t header;
+    if (!get(&header))
+        return false;
+    if ((header >> trace_type_bits) > UINT32_MAX) {
+        _malformed = true;
+        return false;
+    }
+    record->type = (trace_type_t)(header & trace_type_mask);
+    _last_us += unzigzag((uint32_t)(header >> trace_type_bits));
+    record->time_us = _last_us;
+
+    uint32_t value, flags;
+    switch (record->type) {
+    case TRACE_START:
+        if (!get(&record->time_us) || !get(&record->version) || !get(&record->seed) ||
+            !get(&record->near_dist) || !get(&record->far_dist) || !get(&record->still_range) || !get(&flags))
+            return false;
+        record->early_accept = flags & 1;
+        _last_us = record->time_us;
+        return true;
+    case TRACE_SAMPLE:
+        if (!get(&value))
+            return false;
+        _last_distance += unzigzag(value);
+        record->distance = _last_distance;
+        return true;
+    case TRACE_BUTTON:
+        return true;
+    case TRACE_INSTRUCTION:
+        if (!get(&record->time_us) || !get(&value) || !get(&record->rate_us))
+            return false;
+        record->instruction = (int)value;
+        _last_us = record->time_us;
+        _last_distance = 0;
+        return true;
+    case TRACE_VERDICT:
+        if (!get(&flags) || !get(&value) || !get(&record->reaction_us))
+            return false;
+        record->verdict = {(flags & trace_verdict_correct) != 0, (uint8_t)value};
+        record->early = flags & trace_verdict_early;
+        return true;
+    case TRACE_END:
+        return get(&record->score) && get(&record->dropped);
+    default:
+        _malformed = true;
+        return false;
+    }
+}
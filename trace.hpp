@@ -0,0 +1,199 @@
+/**
+ * @file trace.hpp
+ * @author Angela Zhu, Fillis Zou
+ * @version 1.0
+ *
+ * @brief compact binary trace of a game: every sample the classifier
+ *        was given, the button presses, the instructions and their
+ *        verdicts, so a game can be judged again offline
+ *        (sim/replay_trace.cpp).
+ *
+ * Every record starts with a varint holding its type in the low 3 bits
+ * and, above them, the time since the previous record in us (zigzag, as
+ * samples can be stamped slightly before the record written ahead of
+ * them). Fields are varints too. An instruction record carries its own
+ * time and no delta, so decoding can start over at any of them: when the
+ * buffer fills up, the oldest instructions are dropped, never the last.
+ */
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include "gesture.hpp"
+#include "hal.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// bump when the records change, older traces are then refused
+#define trace_version 1
+// bytes of RAM holding the trace of the current (or last) game
+#define trace_capacity 8192
+// store key of the last game's trace
+#define trace_key "last_trace"
+
+/**
+ * @brief Record types, 3 bits.
+ */
+typedef enum {
+    // the game's settings, always the first record
+    TRACE_START = 0,
+    // a sample given to the classifier
+    TRACE_SAMPLE = 1,
+    // a button press, as seen by the game
+    TRACE_BUTTON = 2,
+    // an instruction shown, the classifier starts over
+    TRACE_INSTRUCTION = 3,
+    // the verdict on the last instruction
+    TRACE_VERDICT = 4,
+    // the game is over
+    TRACE_END = 5
+} trace_type_t;
+
+/**
+ * @brief One decoded record. Only the fields of its type are set.
+ */
+typedef struct {
+    trace_type_t type;
+    // Clock::now() us
+    uint32_t time_us;
+
+    // TRACE_START
+    uint32_t version;
+    uint32_t seed;
+    uint32_t near_dist;
+    uint32_t far_dist;
+    uint32_t still_range;
+    bool early_accept;
+
+    // TRACE_SAMPLE, mm
+    uint32_t distance;
+
+    // TRACE_INSTRUCTION
+    int instruction;
+    uint32_t rate_us;
+
+    // TRACE_VERDICT
+    verdict_t verdict;
+    // ended by early accept, and the reaction time it was accepted on
+    bool early;
+    uint32_t reaction_us;
+
+    // TRACE_END, and the instructions dropped to make room
+    uint32_t score;
+    uint32_t dropped;
+} trace_record_t;
+
+/**
+ * @brief Records the current game, in a fixed buffer.
+ *
+ * Only records between start() and end() are kept; the trace stays in
+ * the buffer until the next start(). Every call is a few varints, on the
+ * game thread.
+ */
+class TraceWriter
+{
+public:
+    /**
+     * @brief Start the trace of a new game, dropping the last one.
+     */
+    void start(uint32_t time_us, uint32_t seed, uint32_t near_dist, uint32_t far_dist,
+               uint32_t still_range, bool early_accept);
+
+    void sample(uint32_t time_us, uint32_t distance);
+
+    void button(uint32_t time_us);
+
+    void instruction(uint32_t time_us, int instruction, uint32_t rate_us);
+
+    void verdict(uint32_t time_us, const verdict_t &verdict, bool early, uint32_t reaction_us);
+
+    void end(uint32_t time_us, uint32_t score);
+
+    /**
+     * @brief Store the trace under trace_key. Blocks on the flash.
+     *
+     * @return 0 on success, or the store's error.
+     */
+    int save(RecordStore &store) const;
+
+    /**
+     * @brief Replace the trace with the stored one.
+     *        Only call while no game is recorded.
+     *
+     * @return 0 on success, negative if there is none or a game is recorded.
+     */
+    int load(RecordStore &store);
+
+    bool active() const { return _active; }
+
+    const uint8_t *data() const { return _buf; }
+
+    size_t size() const { return _size; }
+
+    /**
+     * @brief Instructions dropped from the front to make room.
+     */
+    uint32_t dropped() const { return _dropped; }
+
+private:
+    /**
+     * @brief Write the varint header of a record of type at time_us,
+     *        with room for that many varint fields after it.
+     *
+     * @return false if there is no room, even after dropping instructions.
+     */
+    bool begin(trace_type_t type, uint32_t time_us, size_t fields);
+
+    void put(uint32_t value);
+
+    /**
+     * @brief Drop the oldest instruction (with its samples and verdict).
+     */
+    bool drop_instruction();
+
+    uint8_t _buf[trace_capacity];
+    size_t _size = 0;
+    // end of the start record, which is never dropped
+    size_t _header = 0;
+    uint32_t _last_us = 0;
+    uint32_t _last_distance = 0;
+    uint32_t _dropped = 0;
+    bool _active = false;
+};
+
+/**
+ * @brief Decodes a trace one record at a time, like NdefWalker.
+ */
+class TraceReader
+{
+public:
+    TraceReader(const uint8_t *data, size_t size) : _data(data), _size(size) { }
+
+    /**
+     * @brief Decode the next record into record.
+     *
+     * @return false at the end of the trace, or if it is malformed.
+     */
+    bool next(trace_record_t *record);
+
+    bool malformed() const { return _malformed; }
+
+    /**
+     * @brief Offset of the next record.
+     */
+    size_t offset() const { return _offset; }
+
+private:
+    bool get(uint64_t *value);
+
+    bool get(uint32_t *value);
+
+    const uint8_t *_data;
+    size_t _size;
+    size_t _offset = 0;
+    uint32_t _last_us = 0;
+    uint32_t _last_distance = 0;
+    bool _malformed = false;
+};
+
+#endif